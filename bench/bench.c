@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+static SDL_malloc_func real_malloc;
+static SDL_calloc_func real_calloc;
+static SDL_realloc_func real_realloc;
+static SDL_free_func real_free;
+static size_t nallocs;
+
+/*
+ * Counting wrappers around SDL allocation functions. Only allocations
+ * made through SDL_malloc and friends are seen: zlib and the few plain
+ * calloc calls of pcfread aren't.
+ */
+static void *counting_malloc(size_t size)
+{
+    nallocs++;
+    return real_malloc(size);
+}
+
+static void *counting_calloc(size_t nmemb, size_t size)
+{
+    nallocs++;
+    return real_calloc(nmemb, size);
+}
+
+static void *counting_realloc(void *mem, size_t size)
+{
+    nallocs++;
+    return real_realloc(mem, size);
+}
+
+static void counting_free(void *mem)
+{
+    real_free(mem);
+}
+
+/**
+ * Sets up SDL for headless benchmarking: dummy video driver, allocation
+ * counting. Must be called before any other SDL or SDL_pcf function.
+ *
+ * Usage of all benchmarks: program [font-filename] [iterations]
+ *
+ * @param argc main's argc
+ * @param argv main's argv
+ * @param font Will be set to the font to bench with.
+ * @param iterations Will be set to the number of iterations of each
+ * benchmark.
+ * @return true on success, false otherwise (a message has been printed).
+ */
+bool bench_init(int argc, char *argv[], const char **font, int *iterations)
+{
+    SDL_GetMemoryFunctions(&real_malloc, &real_calloc, &real_realloc, &real_free);
+    SDL_SetMemoryFunctions(counting_malloc, counting_calloc, counting_realloc, counting_free);
+
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+    if(SDL_Init(SDL_INIT_VIDEO) < 0){
+        printf("Couldn't initialize SDL: %s\n", SDL_GetError());
+        return false;
+    }
+
+    *font = argc > 1 ? argv[1] : BENCH_FONT;
+    *iterations = argc > 2 ? atoi(argv[2]) : BENCH_ITERATIONS;
+    if(*iterations <= 0){
+        printf("Invalid number of iterations: %s\n", argv[2]);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Shuts SDL down, to be called once done with benchmarks.
+ */
+void bench_quit(void)
+{
+    SDL_Quit();
+}
+
+/**
+ * Starts timing a benchmark. Nothing else than the code to measure
+ * should run until the matching bench_end_* call.
+ *
+ * @param run The benchmark to start.
+ * @param name What is measured, printed by bench_end_*.
+ */
+void bench_begin(BenchRun *run, const char *name)
+{
+    run->name = name;
+    run->allocs = nallocs;
+    run->start = SDL_GetPerformanceCounter();
+}
+
+/**
+ * Stops timing a benchmark that handled glyphs and prints its
+ * throughput: glyphs/s, ns/glyph and allocations per iteration.
+ *
+ * @param run The benchmark to stop.
+ * @param iterations How many times the measured code has run.
+ * @param glyphs The number of glyphs handled by each iteration.
+ */
+void bench_end_glyphs(BenchRun *run, int iterations, size_t glyphs)
+{
+    Uint64 elapsed;
+    double ns, total;
+
+    elapsed = SDL_GetPerformanceCounter() - run->start;
+    ns = elapsed * 1e9 / SDL_GetPerformanceFrequency();
+    total = (double)iterations * glyphs;
+
+    printf("%-44s %12.0f glyphs/s %9.2f ns/glyph %8.2f allocs/iter\n",
+        run->name,
+        total * 1e9 / ns,
+        ns / total,
+        (nallocs - run->allocs) / (double)iterations
+    );
+}
+
+/**
+ * Stops timing a benchmark that loads or creates a font and prints the
+ * time and allocations each load took.
+ *
+ * @param run The benchmark to stop.
+ * @param iterations How many times the measured code has run.
+ */
+void bench_end_load(BenchRun *run, int iterations)
+{
+    Uint64 elapsed;
+    double ms;
+
+    elapsed = SDL_GetPerformanceCounter() - run->start;
+    ms = elapsed * 1e3 / SDL_GetPerformanceFrequency();
+
+    printf("%-44s %12.3f ms/load %28.2f allocs/load\n",
+        run->name,
+        ms / iterations,
+        (nallocs - run->allocs) / (double)iterations
+    );
+}
@@ -0,0 +1,25 @@
+#ifndef BENCH_H
+#define BENCH_H
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <SDL.h>
+
+/*Default number of iterations of each benchmark, see bench_init*/
+#define BENCH_ITERATIONS 10000
+/*Font used when none is given on the command line*/
+#define BENCH_FONT "ter-x24n.pcf.gz"
+
+typedef struct{
+    const char *name;
+    Uint64 start;
+    size_t allocs; /*Count when the run began*/
+}BenchRun;
+
+bool bench_init(int argc, char *argv[], const char **font, int *iterations);
+void bench_quit(void);
+void bench_begin(BenchRun *run, const char *name);
+void bench_end_glyphs(BenchRun *run, int iterations, size_t glyphs);
+void bench_end_load(BenchRun *run, int iterations);
+
+#endif /* BENCH_H */
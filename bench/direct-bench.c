@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "SDL_pcf.h"
+#include "bench.h"
+
+/*
+ * Times direct writing: font loading, PCF_FontWriteChar and PCF_FontWrite
+ * on surfaces of each depth, PCF_FontRender on a software renderer and
+ * the measurement functions.
+ * Usage: direct-bench [font-filename] [iterations]
+ */
+int main(int argc, char *argv[])
+{
+    const Uint32 formats[] = {
+        SDL_PIXELFORMAT_INDEX8,
+        SDL_PIXELFORMAT_RGB565,
+        SDL_PIXELFORMAT_RGB24,
+        SDL_PIXELFORMAT_RGBA8888
+    };
+    const char *filename;
+    int iterations, loads;
+    PCF_Font *font;
+    SDL_Surface *surface;
+    SDL_Renderer *renderer;
+    SDL_Rect location;
+    BenchRun run;
+    Uint32 color, w, h;
+    size_t len;
+    char name[64];
+
+    if(!bench_init(argc, argv, &filename, &iterations))
+        exit(EXIT_FAILURE);
+    len = strlen(ASCII_PRINTABLE);
+    loads = SDL_max(iterations / 100, 1);
+
+    bench_begin(&run, "PCF_OpenFont");
+    for(int i = 0; i < loads; i++){
+        font = PCF_OpenFont(filename);
+        if(!font){
+            printf("%s\n", SDL_GetError());
+            exit(EXIT_FAILURE);
+        }
+        if(i < loads - 1)
+            PCF_CloseFont(font);
+    }
+    bench_end_load(&run, loads);
+
+    for(size_t f = 0; f < SDL_arraysize(formats); f++){
+        PCF_FontGetSizeRequest(font, ASCII_PRINTABLE, false, &w, &h);
+        surface = SDL_CreateRGBSurfaceWithFormat(0, w, h, 0, formats[f]);
+        if(!surface){
+            printf("%s\n", SDL_GetError());
+            exit(EXIT_FAILURE);
+        }
+        color = SDL_MapRGB(surface->format, 255, 255, 255);
+
+        snprintf(name, sizeof(name), "PCF_FontWriteChar %dbpp", surface->format->BitsPerPixel);
+        bench_begin(&run, name);
+        for(int i = 0; i < iterations; i++){
+            location = (SDL_Rect){0, 0, 0, 0};
+            for(size_t j = 0; j < len; j++)
+                PCF_FontWriteChar(font, ASCII_PRINTABLE[j], color, surface, &location);
+        }
+        bench_end_glyphs(&run, iterations, len);
+
+        snprintf(name, sizeof(name), "PCF_FontWrite %dbpp", surface->format->BitsPerPixel);
+        bench_begin(&run, name);
+        for(int i = 0; i < iterations; i++){
+            location = (SDL_Rect){0, 0, 0, 0};
+            PCF_FontWrite(font, ASCII_PRINTABLE, color, false, surface, &location);
+        }
+        bench_end_glyphs(&run, iterations, len);
+
+        SDL_FreeSurface(surface);
+    }
+
+    surface = SDL_CreateRGBSurfaceWithFormat(0, w, h, 0, SDL_PIXELFORMAT_RGBA8888);
+    renderer = SDL_CreateSoftwareRenderer(surface);
+    if(!renderer){
+        printf("%s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+    bench_begin(&run, "PCF_FontRender (software)");
+    for(int i = 0; i < iterations; i++){
+        location = (SDL_Rect){0, 0, 0, 0};
+        PCF_FontRender(font, ASCII_PRINTABLE, &(SDL_Color){255, 255, 255, 255}, false, renderer, &location);
+    }
+    bench_end_glyphs(&run, iterations, len);
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(surface);
+
+    bench_begin(&run, "PCF_FontGetSizeRequest");
+    for(int i = 0; i < iterations; i++)
+        PCF_FontGetSizeRequest(font, ASCII_PRINTABLE, false, &w, &h);
+    bench_end_glyphs(&run, iterations, len);
+
+    bench_begin(&run, "PCF_FontGetSizeRequest (tight)");
+    for(int i = 0; i < iterations; i++)
+        PCF_FontGetSizeRequest(font, ASCII_PRINTABLE, true, &w, &h);
+    bench_end_glyphs(&run, iterations, len);
+
+    bench_begin(&run, "PCF_FontGetStringMaxInkAscent");
+    for(int i = 0; i < iterations; i++)
+        h = PCF_FontGetStringMaxInkAscent(font, ASCII_PRINTABLE);
+    bench_end_glyphs(&run, iterations, len);
+
+    bench_begin(&run, "PCF_FontGetStringTopInkOffset");
+    for(int i = 0; i < iterations; i++)
+        h = PCF_FontGetStringTopInkOffset(font, ASCII_PRINTABLE);
+    bench_end_glyphs(&run, iterations, len);
+
+    PCF_CloseFont(font);
+    bench_quit();
+
+    exit(EXIT_SUCCESS);
+}
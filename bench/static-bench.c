@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "SDL_pcf.h"
+#include "bench.h"
+
+/*
+ * Times static fonts: creation and PCF_StaticFontPreWriteString(Offset)
+ * over the whole ASCII_PRINTABLE set, plus the measurement functions.
+ * Usage: static-bench [font-filename] [iterations]
+ */
+int main(int argc, char *argv[])
+{
+    const char *filename;
+    int iterations, loads;
+    PCF_Font *font;
+    PCF_StaticFont *sfont;
+    PCF_StaticFontPatch *patches;
+    SDL_Rect location;
+    BenchRun run;
+    Uint32 w, h;
+    size_t len;
+
+    if(!bench_init(argc, argv, &filename, &iterations))
+        exit(EXIT_FAILURE);
+    len = strlen(ASCII_PRINTABLE);
+    loads = SDL_max(iterations / 100, 1);
+
+    font = PCF_OpenFont(filename);
+    if(!font){
+        printf("%s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+
+    bench_begin(&run, "PCF_FontCreateStaticFont");
+    for(int i = 0; i < loads; i++){
+        sfont = PCF_FontCreateStaticFont(font, &(SDL_Color){255, 255, 255, 255}, 1, ASCII_PRINTABLE);
+        if(!sfont){
+            printf("%s\n", SDL_GetError());
+            exit(EXIT_FAILURE);
+        }
+        if(i < loads - 1)
+            PCF_FreeStaticFont(sfont);
+    }
+    bench_end_load(&run, loads);
+    PCF_CloseFont(font);
+
+    patches = calloc(len, sizeof(PCF_StaticFontPatch));
+
+    bench_begin(&run, "PCF_StaticFontPreWriteString");
+    for(int i = 0; i < iterations; i++){
+        location = (SDL_Rect){0, 0, 0, 0};
+        PCF_StaticFontPreWriteString(sfont, len, ASCII_PRINTABLE, false, &location, len, patches);
+    }
+    bench_end_glyphs(&run, iterations, len);
+
+    bench_begin(&run, "PCF_StaticFontPreWriteString (tight)");
+    for(int i = 0; i < iterations; i++){
+        location = (SDL_Rect){0, 0, 0, 0};
+        PCF_StaticFontPreWriteString(sfont, len, ASCII_PRINTABLE, true, &location, len, patches);
+    }
+    bench_end_glyphs(&run, iterations, len);
+
+    /*location is the clipping area of the Offset variant*/
+    PCF_StaticFontGetSizeRequest(sfont, ASCII_PRINTABLE, false, &w, &h);
+    bench_begin(&run, "PCF_StaticFontPreWriteStringOffset");
+    for(int i = 0; i < iterations; i++){
+        location = (SDL_Rect){0, 0, w, h};
+        PCF_StaticFontPreWriteStringOffset(sfont, len, ASCII_PRINTABLE, false, &location,
+                                           i % 7, i % 5, len, patches);
+    }
+    bench_end_glyphs(&run, iterations, len);
+
+    bench_begin(&run, "PCF_StaticFontGetSizeRequest");
+    for(int i = 0; i < iterations; i++)
+        PCF_StaticFontGetSizeRequest(sfont, ASCII_PRINTABLE, false, &w, &h);
+    bench_end_glyphs(&run, iterations, len);
+
+    bench_begin(&run, "PCF_StaticFontGetSizeRequest (tight)");
+    for(int i = 0; i < iterations; i++)
+        PCF_StaticFontGetSizeRequest(sfont, ASCII_PRINTABLE, true, &w, &h);
+    bench_end_glyphs(&run, iterations, len);
+
+    bench_begin(&run, "PCF_StaticFontGetStringMaxInkAscent");
+    for(int i = 0; i < iterations; i++)
+        h = PCF_StaticFontGetStringMaxInkAscent(sfont, ASCII_PRINTABLE);
+    bench_end_glyphs(&run, iterations, len);
+
+    free(patches);
+    PCF_FreeStaticFont(sfont);
+    bench_quit();
+
+    exit(EXIT_SUCCESS);
+}
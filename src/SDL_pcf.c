@@ -6,11 +6,14 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <math.h>
 
 #include "SDL_error.h"
 #include "SDL_pixels.h"
 #include "pcf.h"
 #include "pcfread.h"
+#include "pcfstats.h"
+#include "pcftrace.h"
 #include "SDL_pcf.h"
 #include "SDL_GzRW.h"
 #include "SDL_stdinc.h"
@@ -31,11 +34,53 @@
     _a > _b ? _a : _b;       \
 })
 
+#ifdef MIN
+#undef MIN
+#endif
+#define MIN(a,b)             \
+({                           \
+    __typeof__ (a) _a = (a); \
+    __typeof__ (b) _b = (b); \
+    _a < _b ? _a : _b;       \
+})
+
+
+/*Widest number: 127 zero-padded digits grouped by three, a sign and a NUL*/
+#define PCF_NUMBER_BUFFER_SIZE 176
+/*Floating-point numbers are formatted from value * 10^precision in 64 bits*/
+#define PCF_NUMBER_MAX_DECIMALS 18
+#define PCF_NUMBER_FLAGS (NumberTruncate | NumberThousands)
 
 typedef void (*PixelLighter)(Uint8 *ptr, Uint32 color);
+typedef int (*AdvanceGetter)(void *font, Uint32 c);
+
+#if USE_SDL2_TEXTURE
+typedef SDL_Texture PCF_AtlasTexture;
+#elif USE_SGPU_TEXTURE
+typedef GPU_Image PCF_AtlasTexture;
+#endif
 
-static void filter_dedup(char *base, size_t len);
-static bool number_to_ascii(void *value, PCF_NumberType type, int8_t precision, char *buffer, size_t buffer_len);
+/*Atlas pages shared by the static fonts of a PCF_AtlasBuilder*/
+struct _PCF_SharedAtlas{
+    int refcnt;
+    Uint8 npages;
+    SDL_Surface **pages;
+    PCF_AtlasTexture **textures;
+};
+
+static size_t filter_dedup(Uint32 *base, size_t len);
+static int compare_codepoints(const void *a, const void *b);
+static int utf8_decode(const char *str, size_t len, Uint32 *cp);
+static bool PCF_StaticFontIndexGlyph(PCF_StaticFont *font, Uint32 c, int i);
+static void PCF_SharedAtlasUnref(PCF_SharedAtlas *self);
+static CharInfoRec *PCF_FontLookupGlyph(PCF_Font *font, Uint32 c);
+static char *number_format(void *value, PCF_NumberType type, int8_t precision, char *buffer);
+static void PCF_FontInitAdvances(PCF_Font *font);
+
+#if PCF_HAVE_STATS
+PCF_Stats pcf_stats;
+#endif
+PCF_TraceHooks pcf_trace;
 
 
 PCF_Font *PCF_FontInit(PCF_Font *self, const char *filename)
@@ -44,7 +89,7 @@ PCF_Font *PCF_FontInit(PCF_Font *self, const char *filename)
     int glyph = 4; /*see pcfReadFont comments in pcfread.c*/
     int scan = 1;
     int rv;
-
+    PCF_STATS_TICK(tick);
 
     stream = SDL_RWFromGzFile(filename, "rb");
     if(!stream){
@@ -57,6 +102,13 @@ PCF_Font *PCF_FontInit(PCF_Font *self, const char *filename)
     if(rv != Successful)
         return NULL;
 
+    for(int i = 0; i < 256; i++)
+        self->latin1[i] = PCF_FontLookupGlyph(self, i);
+    PCF_FontInitAdvances(self);
+
+    PCF_STATS_LAP(tick, total);
+    PCF_STATS_INC(fonts_loaded);
+    PCF_STATS_ADD(font_bytes, PCF_FontGetMemoryUsage(self, NULL));
     return self;
 }
 
@@ -72,10 +124,13 @@ PCF_Font *PCF_OpenFont(const char *filename)
     PCF_Font *rv;
 
     rv = SDL_calloc(1, sizeof(PCF_Font));
+    PCF_TRACE_BEGIN("PCF_OpenFont", rv);
     if(!PCF_FontInit(rv, filename)){
+        PCF_TRACE_END("PCF_OpenFont", rv);
         SDL_free(rv);
         return NULL;
     }
+    PCF_TRACE_END("PCF_OpenFont", rv);
     return rv;
 }
 
@@ -97,6 +152,219 @@ void PCF_CloseFont(PCF_Font *self)
     }
 }
 
+/*
+ * Finds the glyph for Unicode codepoint @p c, going through the font
+ * encoding table. Internal use only, see PCF_FontGetGlyph.
+ *
+ * @return the glyph or NULL if the font has none for @p c.
+ */
+static CharInfoRec *PCF_FontLookupGlyph(PCF_Font *font, Uint32 c)
+{
+    FontInfoRec *info;
+    int row, col;
+
+    info = &font->xfont.info;
+    row = c >> 8;
+    col = c & 0xff;
+    if(   c > 0xffff
+       || row < info->firstRow || row > info->lastRow
+       || col < info->firstCol || col > info->lastCol)
+        return NULL;
+
+    return ACCESSENCODING(font->xfont.fontPrivate->encoding,
+        (row - info->firstRow) * (info->lastCol - info->firstCol + 1) + (col - info->firstCol)
+    );
+}
+
+/*
+ * Finds the glyph for Unicode codepoint @p c. ASCII and Latin-1 go
+ * through a flat table built when opening the font, other codepoints
+ * through the (two-level) encoding table. Internal use only.
+ *
+ * @return the glyph or NULL if the font has none for @p c.
+ */
+static inline CharInfoRec *PCF_FontGetGlyph(PCF_Font *font, Uint32 c)
+{
+    if(c < 256)
+        return font->latin1[c];
+    return PCF_FontLookupGlyph(font, c);
+}
+
+/*
+ * Ink metrics of @p glyph, falling back to its regular metrics
+ * when the font has no ink metrics.
+ */
+static xCharInfo *PCF_FontGetGlyphInkMetrics(PCF_Font *font, CharInfoRec *glyph)
+{
+    BitmapFontRec *bitmapFont;
+
+    bitmapFont = font->xfont.fontPrivate;
+    if(!bitmapFont->ink_metrics)
+        return &glyph->metrics;
+    return &bitmapFont->ink_metrics[glyph - bitmapFont->metrics];
+}
+
+/*
+ * Horizontal advance of @p glyph, the default glyph being used for missing
+ * ones. Spaces missing from the font advance by PCF_FontCharWidth.
+ */
+static inline int PCF_FontGlyphAdvance(PCF_Font *font, CharInfoRec *glyph, Uint32 c)
+{
+    if(!glyph && c != ' ')
+        glyph = font->xfont.fontPrivate->pDefault;
+    return glyph ? glyph->metrics.characterWidth : PCF_FontCharWidth(font);
+}
+
+/*
+ * Fills font->advances and tells whether @p font is monospace: all
+ * glyphs have the same advance and their bitmaps don't go past it.
+ */
+static void PCF_FontInitAdvances(PCF_Font *font)
+{
+    BitmapFontRec *bitmapFont;
+    xCharInfo *m;
+
+    for(int i = 0; i < 256; i++)
+        font->advances[i] = PCF_FontGlyphAdvance(font, font->latin1[i], i);
+
+    bitmapFont = font->xfont.fontPrivate;
+    font->monospace = true;
+    for(int i = 0; i < bitmapFont->num_chars && font->monospace; i++){
+        m = &bitmapFont->metrics[i].metrics;
+        font->monospace =    m->characterWidth == PCF_FontCharWidth(font)
+                          && m->leftSideBearing >= 0
+                          && m->rightSideBearing <= m->characterWidth;
+    }
+}
+
+/*
+ * Horizontal advance of Unicode codepoint @p c. Internal use only.
+ */
+static inline int PCF_FontGetAdvance(PCF_Font *font, Uint32 c)
+{
+    if(font->monospace)
+        return PCF_FontCharWidth(font);
+    if(c < 256)
+        return font->advances[c];
+    return PCF_FontGlyphAdvance(font, PCF_FontLookupGlyph(font, c), c);
+}
+
+/*
+ * Decodes the codepoint starting at @p str[*i] and moves @p i past it.
+ * ASCII bytes don't go through utf8_decode.
+ */
+static inline Uint32 next_codepoint(const char *str, int len, int *i)
+{
+    Uint32 rv;
+
+    if((unsigned char)str[*i] < 0x80)
+        return (unsigned char)str[(*i)++];
+    *i += utf8_decode(str + *i, len - *i, &rv);
+    return rv;
+}
+
+/*
+ * Width in pixels of the first @p len bytes of @p str. Monospace fonts only
+ * need to count chars, ASCII runs of proportional fonts are summed
+ * straight from font->advances.
+ */
+static int PCF_FontMeasure(PCF_Font *font, const char *str, int len)
+{
+    int rv, i;
+
+    rv = 0;
+    if(font->monospace){
+        for(i = 0; i < len; rv++)
+            next_codepoint(str, len, &i);
+        return rv * PCF_FontCharWidth(font);
+    }
+    for(i = 0; i < len; ){
+        for(; i < len && (unsigned char)str[i] < 0x80; i++)
+            rv += font->advances[(unsigned char)str[i]];
+        if(i < len)
+            rv += PCF_FontGetAdvance(font, next_codepoint(str, len, &i));
+    }
+    return rv;
+}
+
+/*
+ * AdvanceGetter for PCF_Font.
+ */
+static int font_advance(void *font, Uint32 c)
+{
+    return PCF_FontGetAdvance(font, c);
+}
+
+/*
+ * Finds where the line starting at @p str[@p start] ends: at '\n', or
+ * before the word that would make it wider than @p max_w pixels when
+ * @p wrap is true. Words that don't fit on a line by themselves are
+ * broken anywhere. Char widths are given by @p advance.
+ *
+ * @param end Set to the end of the line, trailing spaces excluded.
+ * @param width Set to the width of the line up to @p end.
+ * @return the start of the next line, spaces at a wrap point skipped.
+ */
+static int layout_line(const char *str, int len, int start, AdvanceGetter advance, void *font,
+                       int max_w, bool wrap, int *end, int *width)
+{
+    int i, next, adv;
+    int w, ink_end, ink_w;
+    int brk_end, brk_w, word_start;
+    bool prev_space;
+    Uint32 c;
+
+    w = ink_w = brk_w = 0;
+    ink_end = brk_end = word_start = start;
+    prev_space = false;
+    for(i = start; i < len; i = next){
+        next = i;
+        c = next_codepoint(str, len, &next);
+        if(c == '\n')
+            break;
+        adv = advance(font, c);
+        if(c == ' '){
+            if(!prev_space && ink_end > start){
+                brk_end = ink_end;
+                brk_w = ink_w;
+            }
+            prev_space = true;
+        }else{
+            if(prev_space)
+                word_start = i;
+            prev_space = false;
+            if(wrap && w + adv > max_w && ink_end > start){
+                if(brk_end > start){
+                    *end = brk_end;
+                    *width = brk_w;
+                    return word_start;
+                }
+                *end = i;
+                *width = w;
+                return i;
+            }
+            ink_end = next;
+            ink_w = w + adv;
+        }
+        w += adv;
+    }
+    *end = ink_end;
+    *width = ink_w;
+    return (i < len) ? next : len;
+}
+
+/*
+ * Left edge of a @p width pixels wide line in @p box.
+ */
+static inline int layout_line_x(SDL_Rect *box, int width, PCF_BoxFlags flags)
+{
+    if(flags & BoxAlignRight)
+        return box->x + box->w - width;
+    if(flags & BoxAlignCenter)
+        return box->x + (box->w - width) / 2;
+    return box->x;
+}
+
 static void lit_pixel_1bpp(Uint8 *ptr, Uint32 color)
 {
     *ptr = color;
@@ -142,44 +410,27 @@ static PixelLighter SDL_SurfaceGetLighter(SDL_Surface *surface)
     }
 }
 
-/**
- * Writes a character on screen, and advance the location by one char width.
- * If the surface is too small to fit the char or if the glyph is partly out
- * of the surface (start writing a 18 pixel wide char 2 pixels before the edge)
- * only the pixels that can be written will be drawn, resulting in a partly
- * drawn glyph and the function will return false.
+/*
+ * Draws the bitmap of @p glyph with its top-left corner at @p x, @p y
+ * on @p destination, clipping as needed. Does nothing (successfully)
+ * when @p glyph is NULL. Internal use only.
  *
- * @param c The ASCII code of the char to write. You can of course use 'a'
- * instead of 97. Be sure to cast values to unsigned char when dealing with
- * values over 127.
- * @param font The font to use to write the char. Opened by PCF_OpenFont.
- * @param color The color of text. Must be in @param destination format (use
- * SDL_MapRGB/SDL_MapRGBA to build a suitable value).
- * @param destination The surface to write to.
- * @param location Where to write on the surface. Can be NULL to write at
- * 0,0. If not NULL, location will be advanced by the width.
- * @return True on success(the whole char has been written), false on error/partial
- * draw. Details of the failure can be retreived with SDL_GetError().
+ * @return false if the glyph couldn't be drawn at all, true otherwise
  */
-bool PCF_FontWriteChar(PCF_Font *font, int c, Uint32 color, SDL_Surface *destination, SDL_Rect *location)
+static bool PCF_FontDrawGlyph(PCF_Font *font, CharInfoRec *glyph, Uint32 color, SDL_Surface *destination, int x, int y)
 {
     int w, h;
     int line_bsize;
-    CharInfoRec *glyph;
-    BitmapFontRec *bitmapFont;
     unsigned char byte;
     unsigned char *glyph_line;
     int nbytes;
-    bool rv;
-    Uint8 *pixels, *line_start, *xlimit;
+    Uint8 *line_start;
     PixelLighter lit_pixel;
-    int line_y;
-    rv = true;
-
-    if(c == ' ')
-        goto end;
+    int line_y, col_x;
+    int bpp;
 
-    location = location ? location : &(SDL_Rect){0,0,0,0};
+    if(!glyph)
+        return true;
 
     lit_pixel = SDL_SurfaceGetLighter(destination);
     if(!lit_pixel){
@@ -191,21 +442,12 @@ bool PCF_FontWriteChar(PCF_Font *font, int c, Uint32 color, SDL_Surface *destina
         return false;
     }
 
-    bitmapFont  = font->xfont.fontPrivate;
-    if(c >= bitmapFont->num_chars || c < 0){
-        SDL_SetError("%s: no glyph for char %d, falling back to default glyph", __FUNCTION__, c);
-        glyph = font->xfont.fontPrivate->pDefault;
-        rv = false;
-    }else{
-        glyph = &bitmapFont->metrics[c];
-    }
-
     /*TODO: Check if can do with FontRec struct members*/
     w = glyph->metrics.rightSideBearing - glyph->metrics.leftSideBearing;
     h = glyph->metrics.ascent + glyph->metrics.descent;
 
     /*start after the end of the surface, nothing to draw*/
-    if(location->x >= destination->w || location->y >= destination->h){
+    if(x >= destination->w || y >= destination->h){
         return false;
     }
 
@@ -214,31 +456,140 @@ bool PCF_FontWriteChar(PCF_Font *font, int c, Uint32 color, SDL_Surface *destina
      * */
     line_bsize = ceil(w/(font->xfont.glyph * 8.0))*font->xfont.glyph; /*in bytes*/
     nbytes = ceil(w/(8.0)); /*actual glyph width in bytes (w/o padding)*/
+    bpp = destination->format->BytesPerPixel;
     SDL_LockSurface(destination);
+    PCF_STATS_INC(surface_locks);
     for(int i = 0; i < h; i++){
         glyph_line = (unsigned char*)glyph->bits + (i * line_bsize);
-        line_y = location->y+i;
+        line_y = y+i;
         /*clip y both ways*/
         if(line_y > destination->h-1) break;
         if(line_y < 0) continue;
         line_start = (Uint8 *)destination->pixels + (line_y * destination->pitch);
-        pixels = line_start + location->x * destination->format->BytesPerPixel;
-        xlimit = line_start + destination->w * destination->format->BytesPerPixel;
+        col_x = x;
         for(int j = 0; j < nbytes; j++){
             byte = *(unsigned char*)(glyph_line + j);
-            for(int k = 0; k < 8; k++){
+            for(int k = 0; k < 8; k++, col_x++){
                 if(byte & (1 << k)){
-                    if(pixels < xlimit) /*Clip x*/
-                        lit_pixel(pixels, color);
+                    /*Clip x both ways: glyphs can start left of the surface*/
+                    if(col_x >= 0 && col_x < destination->w){
+                        lit_pixel(line_start + col_x * bpp, color);
+                        PCF_STATS_INC(pixels_lit);
+                    }
                 }
-                pixels += destination->format->BytesPerPixel;
             }
         }
     }
     SDL_UnlockSurface(destination);
 
+    return true;
+}
+
+/*
+ * Same as PCF_FontDrawGlyph, each pixel of the glyph becoming a
+ * @p scale x @p scale block (nearest neighbor upscaling). Internal use only.
+ */
+static bool PCF_FontDrawGlyphScaled(PCF_Font *font, CharInfoRec *glyph, Uint32 color, SDL_Surface *destination,
+                                    int x, int y, int scale)
+{
+    int w, h;
+    int line_bsize;
+    unsigned char *glyph_line;
+    Uint8 *line_start;
+    PixelLighter lit_pixel;
+    int bpp;
+
+    if(scale == 1)
+        return PCF_FontDrawGlyph(font, glyph, color, destination, x, y);
+    if(!glyph)
+        return true;
+
+    lit_pixel = SDL_SurfaceGetLighter(destination);
+    if(!lit_pixel){
+        SDL_SetError("%s: no function to lit pixels on %d bpp surfaces such as %p",
+            __FUNCTION__,
+            destination->format->BytesPerPixel,
+            destination
+        );
+        return false;
+    }
+    if(x >= destination->w || y >= destination->h)
+        return false;
+
+    w = glyph->metrics.rightSideBearing - glyph->metrics.leftSideBearing;
+    h = glyph->metrics.ascent + glyph->metrics.descent;
+    line_bsize = ceil(w/(font->xfont.glyph * 8.0))*font->xfont.glyph; /*in bytes*/
+    bpp = destination->format->BytesPerPixel;
+    SDL_LockSurface(destination);
+    PCF_STATS_INC(surface_locks);
+    for(int i = 0; i < h * scale; i++){
+        int line_y = y + i;
+        if(line_y > destination->h-1) break;
+        if(line_y < 0) continue;
+        glyph_line = (unsigned char*)glyph->bits + ((i / scale) * line_bsize);
+        line_start = (Uint8 *)destination->pixels + (line_y * destination->pitch);
+        for(int j = 0; j < w * scale; j++){
+            int col_x = x + j;
+            if(col_x < 0) continue;
+            if(col_x > destination->w-1) break;
+            if(glyph_line[j / scale / 8] & (1 << ((j / scale) % 8))){
+                lit_pixel(line_start + col_x * bpp, color);
+                PCF_STATS_INC(pixels_lit);
+            }
+        }
+    }
+    SDL_UnlockSurface(destination);
+
+    return true;
+}
+
+/**
+ * Writes a character on screen, and advance the location by one char width.
+ * If the surface is too small to fit the char or if the glyph is partly out
+ * of the surface (start writing a 18 pixel wide char 2 pixels before the edge)
+ * only the pixels that can be written will be drawn, resulting in a partly
+ * drawn glyph and the function will return false.
+ *
+ * @param c The Unicode codepoint of the char to write. You can of course use
+ * 'a' instead of 97. Glyphs are found through the font encoding table.
+ * @param font The font to use to write the char. Opened by PCF_OpenFont.
+ * @param color The color of text. Must be in @param destination format (use
+ * SDL_MapRGB/SDL_MapRGBA to build a suitable value).
+ * @param destination The surface to write to.
+ * @param location Where to write on the surface. Can be NULL to write at
+ * 0,0. If not NULL, location will be advanced by the width.
+ * @return True on success(the whole char has been written), false on error/partial
+ * draw. Details of the failure can be retreived with SDL_GetError().
+ */
+bool PCF_FontWriteChar(PCF_Font *font, int c, Uint32 color, SDL_Surface *destination, SDL_Rect *location)
+{
+    CharInfoRec *glyph;
+    bool rv;
+    rv = true;
+    glyph = NULL;
+
+    location = location ? location : &(SDL_Rect){0,0,0,0};
+
+    if(c == ' ')
+        goto end;
+
+    glyph = (c >= 0) ? PCF_FontGetGlyph(font, c) : NULL;
+    if(!glyph){
+        SDL_SetError("%s: no glyph for char %d, falling back to default glyph", __FUNCTION__, c);
+        glyph = font->xfont.fontPrivate->pDefault;
+        PCF_STATS_INC(default_glyphs);
+        rv = false;
+    }
+
+    if(glyph)
+        PCF_STATS_INC(glyphs_written);
+    if(glyph && !PCF_FontDrawGlyph(font, glyph, color, destination,
+                                   location->x + glyph->metrics.leftSideBearing,
+                                   location->y + font->xfont.info.fontAscent - glyph->metrics.ascent))
+        return false;
+
 end:
-    location->x += font->xfont.fontPrivate->metrics->metrics.characterWidth;
+    location->x += glyph ? glyph->metrics.characterWidth : PCF_FontGetAdvance(font, c);
     return rv;
 }
 
@@ -262,6 +613,19 @@ end:
  * draw. Details of the failure can be retreived with SDL_GetError().
  */
 bool PCF_FontWrite(PCF_Font *font, const char *str, Uint32 color, bool tight, SDL_Surface *destination, SDL_Rect *location)
+{
+    return PCF_FontWriteLen(font, str, strlen(str), color, tight, destination, location);
+}
+
+/**
+ * Same as PCF_FontWrite, for the first @p len bytes of @p str which doesn't
+ * need to be NUL-terminated.
+ *
+ * @param str The string to write.
+ * @param len The length of @p str in bytes.
+ * @see PCF_FontWrite for the other parameters and the return value.
+ */
+bool PCF_FontWriteLen(PCF_Font *font, const char *str, size_t len, Uint32 color, bool tight, SDL_Surface *destination, SDL_Rect *location)
 {
     bool rv;
     int end;
@@ -272,60 +636,43 @@ bool PCF_FontWrite(PCF_Font *font, const char *str, Uint32 color, bool tight, SD
      * TODO: Bench and try
      * */
 
-    end = strlen(str);
+    end = len;
     if(!location)
         location = &cursor;
 
     if(tight){
-        Uint32 offset = PCF_FontGetStringTopInkOffset(font, str);
+        Uint32 offset = PCF_FontGetStringTopInkOffsetLen(font, str, len);
         location->y -= offset;
     }
 
+    PCF_TRACE_BEGIN("PCF_FontWrite", font);
     rv = true;
-    for(int i = 0; i < end; i++){
-        if(!PCF_FontWriteChar(font, (unsigned char)str[i], color, destination, location))
+    for(int i = 0; i < end; ){
+        if(!PCF_FontWriteChar(font, next_codepoint(str, end, &i), color, destination, location))
             rv = false;
     }
+    PCF_TRACE_END("PCF_FontWrite", font);
 
     return rv;
 }
 
-/**
- * @brief Same as PCF_FontWrite, expect that the meaning of location x and y
- * start coordinates can be toggled with the subsquent parameters.
+/*
+ * Top-left corner of a @p width x @p height text whose highest ink
+ * reaches @p ink_ascent pixels above the baseline, placed relatively to
+ * @p col and @p row, see PCF_FontWriteAt. Internal use only.
  *
- * @param str The string to write.
- * @param font The font to use. Opened by PCF_OpenFont.
- * @param color The color of text. Must be in @param destination format (use
- * SDL_MapRGB/SDL_MapRGBA to build a suitable value).
- * @param tight If true, the rendering will use ink metrics (tight bounding box) instead
- * of full font metrics. This trims empty space above and below the text.
- * @param destination The surface to write to.
- * @param col The column to write relative to, see @p placement
- * @param line The line to write relative to, see @p placement
- * @param placement How to place the text relatively to given @p col and @p
- * line, bitfield of one of RightToCol, CenterOnCol, LeftToCol and one of
- * BelowRow, CenterOnRow, AboveRow.
- * @return True on success(the whole string has been written), false on
- * error/partial draw. Details of the failure can be retreived with
- * SDL_GetError().
+ * @return false (and sets the SDL error) if @p placement is incomplete.
  */
-bool PCF_FontWriteAt(PCF_Font *font, const char *str, Uint32 color, bool tight, SDL_Surface *destination, Uint32 col, Uint32 row, PCF_TextPlacement placement)
+static bool PCF_FontPlace(PCF_Font *font, Uint32 width, Uint32 height, int ink_ascent,
+                          Uint32 col, Uint32 row, PCF_TextPlacement placement, SDL_Rect *cursor)
 {
-    bool rv;
-    int end;
-    SDL_Rect cursor = (SDL_Rect){0, 0, 0 ,0};
-    Uint32 width, height;
-
-    PCF_FontGetSizeRequest(font, str, tight, &width, &height);
-
     if(placement & RightToCol){
-        cursor.x = col;
+        cursor->x = col;
     }
     else if(placement & CenterOnCol){
-        cursor.x = col - roundf((width - 1)/2.0f);
+        cursor->x = col - roundf((width - 1)/2.0f);
     }else if(placement & LeftToCol){
-        cursor.x = col - (width - 1); /*-1: Land on x=col with the last char*/
+        cursor->x = col - (width - 1); /*-1: Land on x=col with the last char*/
     }else{
         SDL_SetError("%s: No setting for col placement in %d",
             __FUNCTION__,
@@ -335,15 +682,14 @@ bool PCF_FontWriteAt(PCF_Font *font, const char *str, Uint32 color, bool tight,
     }
 
     if(placement & BelowRow){
-        cursor.y = row;
+        cursor->y = row;
     }else if(placement & CenterOnRow){
-        int ink_ascent = PCF_FontGetStringMaxInkAscent(font, str);
-        int empty_top_pix = PCF_FontMetrics(font).ascent - ink_ascent;
+        int empty_top_pix = font->xfont.info.fontAscent - ink_ascent;
         int glyph_middle = empty_top_pix + roundf(ink_ascent/2.0f);
 
-        cursor.y = row - glyph_middle;
+        cursor->y = row - glyph_middle;
     }else if(placement & AboveRow){
-        cursor.y = row - height - 1;
+        cursor->y = row - height - 1;
     }else{
         SDL_SetError("%s: No setting for line placement in %d",
             __FUNCTION__,
@@ -351,41 +697,132 @@ bool PCF_FontWriteAt(PCF_Font *font, const char *str, Uint32 color, bool tight,
         );
         return false;
     }
-
-    return PCF_FontWrite(font, str, color, tight, destination, &cursor);
+    return true;
 }
 
 /**
- * @brief Writes a number
- *
- * Works just like PCF_FontWrite but avoid having to do a number->string
- * conversion in the client code.
+ * @brief Same as PCF_FontWrite, expect that the meaning of location x and y
+ * start coordinates can be toggled with the subsquent parameters.
  *
- * @param font @see PCF_FontWrite
- * @param value A pointer to the value to write. Can be either a pointer to:
- * int, unsigned int, float, double.
- * @param type Tell the function the type pointed by @p value, using one of
- * PCF_NumberType enum values: TypeInt, TypeIntUnsigned, TypeFloat,
- * TypeDouble.
- * @param precision For int types, the padding to apply, if any. A padding of 2
- * will make numbers below 10 to print as 01,02, etc. For floating-point types,
- * the number of digits to truncate (NOT round) after. 3.141592 with precision=3
- * is "3.141". If 0, the dot and the decimal part will be ignored, e.g 3.141592
- * will be printed as "3".
- * @param color @see PCF_FontWrite
+ * @param str The string to write.
+ * @param font The font to use. Opened by PCF_OpenFont.
+ * @param color The color of text. Must be in @param destination format (use
+ * SDL_MapRGB/SDL_MapRGBA to build a suitable value).
  * @param tight If true, the rendering will use ink metrics (tight bounding box) instead
  * of full font metrics. This trims empty space above and below the text.
- * @param destination @see PCF_FontWrite
- * @param location @see PCF_FontWrite
- * @return False if the number->string conversion fails (SDL_GetError will give
- * details on the failure) otherwise same behavior as PCF_FontWrite
- */
-bool PCF_FontWriteNumber(PCF_Font *font, void *value, PCF_NumberType type, int8_t precision, Uint32 color, bool tight, SDL_Surface *destination, SDL_Rect *location)
-{
-    char buffer[10]; /*9999999999 or 999999999 with a floating dot*/
-    if(!number_to_ascii(value, type, precision, buffer, 10))
+ * @param destination The surface to write to.
+ * @param col The column to write relative to, see @p placement
+ * @param line The line to write relative to, see @p placement
+ * @param placement How to place the text relatively to given @p col and @p
+ * line, bitfield of one of RightToCol, CenterOnCol, LeftToCol and one of
+ * BelowRow, CenterOnRow, AboveRow.
+ * @return True on success(the whole string has been written), false on
+ * error/partial draw. Details of the failure can be retreived with
+ * SDL_GetError().
+ */
+bool PCF_FontWriteAt(PCF_Font *font, const char *str, Uint32 color, bool tight, SDL_Surface *destination, Uint32 col, Uint32 row, PCF_TextPlacement placement)
+{
+    SDL_Rect cursor = (SDL_Rect){0, 0, 0 ,0};
+    Uint32 width, height;
+    int ink_ascent;
+    size_t len;
+
+    len = strlen(str);
+    PCF_FontGetSizeRequestLen(font, str, len, tight, &width, &height);
+    ink_ascent = (placement & CenterOnRow) ? PCF_FontGetStringMaxInkAscentLen(font, str, len) : 0;
+    if(!PCF_FontPlace(font, width, height, ink_ascent, col, row, placement, &cursor))
+        return false;
+
+    return PCF_FontWriteLen(font, str, len, color, tight, destination, &cursor);
+}
+
+/**
+ * Writes a multi-line string within @p box: lines break on '\n' and,
+ * unless BoxNoWrap is set, at word boundaries so that they fit the box
+ * width. Words wider than the box are broken anywhere. Lines that don't
+ * fully fit in the box height are not drawn.
+ *
+ * Each line is measured once to find where it breaks, then drawn: no need
+ * to measure substrings with PCF_FontGetSizeRequest beforehand.
+ *
+ * @param font The font to use. Opened by PCF_OpenFont.
+ * @param str The string to write, UTF-8 encoded.
+ * @param len The length in bytes of @p str, -1 to compute it.
+ * @param color The color of text. Must be in @p destination format (use
+ * SDL_MapRGB/SDL_MapRGBA to build a suitable value).
+ * @param destination The surface to write to.
+ * @param box The area to write in.
+ * @param flags Horizontal alignment of lines (BoxAlignLeft, BoxAlignCenter,
+ * BoxAlignRight), optionally or'ed with BoxNoWrap.
+ * @return the number of bytes of @p str that have been laid out: less than
+ * @p len if the text doesn't fit in the box. The remaining text, if any,
+ * starts at str + returned value.
+ */
+size_t PCF_FontWriteBox(PCF_Font *font, const char *str, int len, Uint32 color, SDL_Surface *destination,
+                        SDL_Rect *box, PCF_BoxFlags flags)
+{
+    SDL_Rect cursor;
+    int start, next, end, width;
+    int line_h;
+
+    if(len < 0)
+        len = strlen(str);
+    line_h = PCF_FontCharHeight(font);
+    cursor.y = box->y;
+    PCF_TRACE_BEGIN("PCF_FontWriteBox", font);
+    for(start = 0; start < len && cursor.y + line_h <= box->y + box->h; start = next){
+        next = layout_line(str, len, start, font_advance, font, box->w, !(flags & BoxNoWrap), &end, &width);
+        cursor.x = layout_line_x(box, width, flags);
+        for(int i = start; i < end; )
+            PCF_FontWriteChar(font, next_codepoint(str, end, &i), color, destination, &cursor);
+        cursor.y += line_h;
+    }
+    PCF_TRACE_END("PCF_FontWriteBox", font);
+
+    return start;
+}
+
+/**
+ * @brief Writes a number
+ *
+ * Works just like PCF_FontWrite but avoid having to do a number->string
+ * conversion in the client code.
+ *
+ * @param font @see PCF_FontWrite
+ * The number is formatted on the stack without going through printf, from
+ * a 64-bit integer: floating-point values are first scaled by
+ * 10^precision and must then fit in 64 bits.
+ *
+ * @param value A pointer to the value to write. Can be either a pointer to:
+ * int, unsigned int, int64_t, uint64_t, float, double.
+ * @param type Tell the function the type pointed by @p value, using one of
+ * PCF_NumberType enum values: TypeInt, TypeIntUnsigned, TypeInt64,
+ * TypeIntUnsigned64, TypeFloat, TypeDouble. Can be or'ed with
+ * NumberThousands to group integer digits by three (1,234,567) and, for
+ * floating-point types, with NumberTruncate.
+ * @param precision For int types, the padding to apply, if any. A padding of 2
+ * will make numbers below 10 to print as 01,02, etc. For floating-point types,
+ * the number of digits to round after (up to 18, 6 if negative). 3.141592
+ * with precision=3 is "3.142", "3.141" with NumberTruncate. Ties round to
+ * even, like printf: 0.125 with precision=2 is "0.12". If 0, the dot
+ * and the decimal part will be ignored, e.g 3.141592 will be printed as "3".
+ * @param color @see PCF_FontWrite
+ * @param tight If true, the rendering will use ink metrics (tight bounding box) instead
+ * of full font metrics. This trims empty space above and below the text.
+ * @param destination @see PCF_FontWrite
+ * @param location @see PCF_FontWrite
+ * @return False if the number->string conversion fails (SDL_GetError will give
+ * details on the failure) otherwise same behavior as PCF_FontWrite
+ */
+bool PCF_FontWriteNumber(PCF_Font *font, void *value, PCF_NumberType type, int8_t precision, Uint32 color, bool tight, SDL_Surface *destination, SDL_Rect *location)
+{
+    char buffer[PCF_NUMBER_BUFFER_SIZE];
+    char *str;
+
+    str = number_format(value, type, precision, buffer);
+    if(!str)
         return false;
-    return PCF_FontWrite(font, buffer, color, tight, destination, location);
+    return PCF_FontWrite(font, str, color, tight, destination, location);
 }
 
 /**
@@ -406,61 +843,33 @@ bool PCF_FontWriteNumber(PCF_Font *font, void *value, PCF_NumberType type, int8_
  */
 bool PCF_FontWriteNumberAt(PCF_Font *font, void *value, PCF_NumberType type, int8_t precision, Uint32 color, bool tight, SDL_Surface *destination, Uint32 col, Uint32 row, PCF_TextPlacement placement)
 {
-    char buffer[10]; /*9999999999 or 999999999 with a floating dot*/
-    if(!number_to_ascii(value, type, precision, buffer, 10))
+    char buffer[PCF_NUMBER_BUFFER_SIZE];
+    char *str;
+
+    str = number_format(value, type, precision, buffer);
+    if(!str)
         return false;
 
-    return PCF_FontWriteAt(font, buffer, color, tight, destination, col, row, placement);
+    return PCF_FontWriteAt(font, str, color, tight, destination, col, row, placement);
 }
 
 
-/**
- * Writes a character on a SDL_Renderer, and advance the given location by one
- * char width.
- * If the renderer is too small to fit the char or if the glyph is partly out
- * of the surface (start writing a 18 pixel wide char 2 pixels before the edge)
- * only the pixels that can be written will be drawn, resulting in a partly
- * drawn glyph and the function will return false.
- *
- * Note that there is no color parameter: This is controlled at the
- * SDL_Renderer level with SDL_SetRenderDrawColor.
- *
- * @param c The ASCII code of the char to write. You can of course use 'a'
- * instead of 97.
- * @param font The font to use to write the char. Opened by PCF_OpenFont.
- * @param renderer The renderer that will be used to draw.
- * @param location Location within the renderer. Can be NULL to write at
- * 0,0. If not NULL, location will be advanced by the width.
- * @return True on success(the whole char has been written), false on error/partial
- * draw. Details of the failure can be retreived with SDL_GetError().
+/*
+ * Same as PCF_FontDrawGlyph, drawing points on @p renderer with its
+ * current color. Internal use only.
  */
-bool PCF_FontRenderChar(PCF_Font *font, int c, SDL_Renderer *renderer, SDL_Rect *location)
+static bool PCF_FontRenderGlyph(PCF_Font *font, CharInfoRec *glyph, SDL_Renderer *renderer, int gx, int gy)
 {
     int w, h;
     int line_bsize;
-    CharInfoRec *glyph;
-    BitmapFontRec *bitmapFont;
     unsigned char byte;
     unsigned char *glyph_line;
     int nbytes;
-    bool rv;
     int y, x;
     int rw, rh;
-    rv = true;
-
-    if(c == ' ')
-        goto end;
-
-    location = location ? location : &(SDL_Rect){0,0,0,0};
 
-    bitmapFont  = font->xfont.fontPrivate;
-    if(c >= bitmapFont->num_chars || c < 0){
-        SDL_SetError("%s: no glyph for char %d, falling back to default glyph", __FUNCTION__, c);
-        glyph = font->xfont.fontPrivate->pDefault;
-        rv = false;
-    }else{
-        glyph = &bitmapFont->metrics[c];
-    }
+    if(!glyph)
+        return true;
 
     /*TODO: Check if can do with FontRec struct members*/
     w = glyph->metrics.rightSideBearing - glyph->metrics.leftSideBearing;
@@ -469,7 +878,7 @@ bool PCF_FontRenderChar(PCF_Font *font, int c, SDL_Renderer *renderer, SDL_Rect
     SDL_GetRendererOutputSize(renderer, &rw, &rh);
 
     /*start after the end of the output size, nothing to draw*/
-    if(location->x >= rw || location->y >= rh){
+    if(gx >= rw || gy >= rh){
         return false;
     }
 
@@ -480,25 +889,77 @@ bool PCF_FontRenderChar(PCF_Font *font, int c, SDL_Renderer *renderer, SDL_Rect
     nbytes = ceil(w/(8.0)); /*actual glyph width in bytes (w/o padding)*/
     for(int i = 0; i < h; i++){
         glyph_line = (unsigned char*)glyph->bits + (i * line_bsize);
-        y = location->y+i;
+        y = gy+i;
         /*clip y both ways*/
         if(y < 0) continue;
         if(y > rh-1) break;
-        x = location->x;
+        x = gx;
         for(int j = 0; j < nbytes; j++){
             byte = *(unsigned char*)(glyph_line + j);
             for(int k = 0; k < 8; k++){
                 if(byte & (1 << k)){
-                    if(x < rw) /*Clip x*/
+                    if(x >= 0 && x < rw){ /*Clip x*/
                         SDL_RenderDrawPoint(renderer, x ,y);
+                        PCF_STATS_INC(pixels_lit);
+                        PCF_STATS_INC(renderer_calls);
+                    }
                 }
                 x++;
             }
         }
     }
+    return true;
+}
+
+/**
+ * Writes a character on a SDL_Renderer, and advance the given location by one
+ * char width.
+ * If the renderer is too small to fit the char or if the glyph is partly out
+ * of the surface (start writing a 18 pixel wide char 2 pixels before the edge)
+ * only the pixels that can be written will be drawn, resulting in a partly
+ * drawn glyph and the function will return false.
+ *
+ * Note that there is no color parameter: This is controlled at the
+ * SDL_Renderer level with SDL_SetRenderDrawColor.
+ *
+ * @param c The Unicode codepoint of the char to write. You can of course use
+ * 'a' instead of 97. Glyphs are found through the font encoding table.
+ * @param font The font to use to write the char. Opened by PCF_OpenFont.
+ * @param renderer The renderer that will be used to draw.
+ * @param location Location within the renderer. Can be NULL to write at
+ * 0,0. If not NULL, location will be advanced by the width.
+ * @return True on success(the whole char has been written), false on error/partial
+ * draw. Details of the failure can be retreived with SDL_GetError().
+ */
+bool PCF_FontRenderChar(PCF_Font *font, int c, SDL_Renderer *renderer, SDL_Rect *location)
+{
+    CharInfoRec *glyph;
+    bool rv;
+    rv = true;
+    glyph = NULL;
+
+    location = location ? location : &(SDL_Rect){0,0,0,0};
+
+    if(c == ' ')
+        goto end;
+
+    glyph = (c >= 0) ? PCF_FontGetGlyph(font, c) : NULL;
+    if(!glyph){
+        SDL_SetError("%s: no glyph for char %d, falling back to default glyph", __FUNCTION__, c);
+        glyph = font->xfont.fontPrivate->pDefault;
+        PCF_STATS_INC(default_glyphs);
+        rv = false;
+    }
+
+    if(glyph)
+        PCF_STATS_INC(glyphs_rendered);
+    if(glyph && !PCF_FontRenderGlyph(font, glyph, renderer,
+                                     location->x + glyph->metrics.leftSideBearing,
+                                     location->y + font->xfont.info.fontAscent - glyph->metrics.ascent))
+        return false;
 
 end:
-    location->x += font->xfont.fontPrivate->metrics->metrics.characterWidth;
+    location->x += glyph ? glyph->metrics.characterWidth : PCF_FontGetAdvance(font, c);
     return rv;
 }
 
@@ -522,6 +983,19 @@ end:
  * draw. Details of the failure can be retreived with SDL_GetError().
  */
 bool PCF_FontRender(PCF_Font *font, const char *str, SDL_Color *color, bool tight, SDL_Renderer *renderer, SDL_Rect *location)
+{
+    return PCF_FontRenderLen(font, str, strlen(str), color, tight, renderer, location);
+}
+
+/**
+ * Same as PCF_FontRender, for the first @p len bytes of @p str which doesn't
+ * need to be NUL-terminated.
+ *
+ * @param str The string to write.
+ * @param len The length of @p str in bytes.
+ * @see PCF_FontRender for the other parameters and the return value.
+ */
+bool PCF_FontRenderLen(PCF_Font *font, const char *str, size_t len, SDL_Color *color, bool tight, SDL_Renderer *renderer, SDL_Rect *location)
 {
     bool rv;
     int end;
@@ -532,23 +1006,27 @@ bool PCF_FontRender(PCF_Font *font, const char *str, SDL_Color *color, bool tigh
      * TODO: Bench and try
      * */
 
-    end = strlen(str);
+    end = len;
     if(!location)
         location = &cursor;
 
-    if(color)
+    if(color){
         SDL_SetRenderDrawColor(renderer, color->r, color->g, color->b, color->a);
+        PCF_STATS_INC(renderer_calls);
+    }
 
     if(tight){
-        Uint32 offset = PCF_FontGetStringTopInkOffset(font, str);
+        Uint32 offset = PCF_FontGetStringTopInkOffsetLen(font, str, len);
         location->y -= offset;
     }
 
+    PCF_TRACE_BEGIN("PCF_FontRender", font);
     rv = true;
-    for(int i = 0; i < end; i++){
-        if(!PCF_FontRenderChar(font, str[i], renderer, location))
+    for(int i = 0; i < end; ){
+        if(!PCF_FontRenderChar(font, next_codepoint(str, end, &i), renderer, location))
             rv = false;
     }
+    PCF_TRACE_END("PCF_FontRender", font);
 
     return rv;
 }
@@ -564,18 +1042,29 @@ bool PCF_FontRender(PCF_Font *font, const char *str, SDL_Color *color, bool tigh
  */
 Uint32 PCF_FontGetStringMaxInkAscent(PCF_Font *font, const char *str)
 {
-    int len;
-    BitmapFontRec *bitmapFont;
-    int rv;
+    return PCF_FontGetStringMaxInkAscentLen(font, str, strlen(str));
+}
 
-    len = strlen(str);
+/**
+ * Same as PCF_FontGetStringMaxInkAscent, for the first @p len bytes of
+ * @p str which doesn't need to be NUL-terminated.
+ *
+ * @param font The font you want to use to write that string
+ * @param str The string to write.
+ * @param len The length of @p str in bytes.
+ *
+ * @returns the height
+ */
+Uint32 PCF_FontGetStringMaxInkAscentLen(PCF_Font *font, const char *str, size_t len)
+{
+    CharInfoRec *glyph;
+    int rv;
 
     rv = 0;
-    bitmapFont  = font->xfont.fontPrivate;
-    for(int i = 0; i < len; i++){
-        int c = (unsigned char)str[i];
-        if(c >= bitmapFont->num_chars) continue;
-        rv = MAX(rv, PCF_FontInkMetrics(font)[c].ascent);
+    for(int i = 0; i < len; ){
+        glyph = PCF_FontGetGlyph(font, next_codepoint(str, len, &i));
+        if(!glyph) continue;
+        rv = MAX(rv, PCF_FontGetGlyphInkMetrics(font, glyph)->ascent);
     }
     return rv;
 }
@@ -605,7 +1094,22 @@ Uint32 PCF_FontGetStringMaxInkAscent(PCF_Font *font, const char *str)
  */
 Uint32 PCF_FontGetStringTopInkOffset(PCF_Font *font, const char *str)
 {
-    return PCF_FontMetrics(font).ascent - PCF_FontGetStringMaxInkAscent(font, str);
+    return font->xfont.info.fontAscent - PCF_FontGetStringMaxInkAscent(font, str);
+}
+
+/**
+ * Same as PCF_FontGetStringTopInkOffset, for the first @p len bytes of
+ * @p str which doesn't need to be NUL-terminated.
+ *
+ * @param font The font you want to use to write that string
+ * @param str The string to write.
+ * @param len The length of @p str in bytes.
+ *
+ * @returns the offset
+ */
+Uint32 PCF_FontGetStringTopInkOffsetLen(PCF_Font *font, const char *str, size_t len)
+{
+    return font->xfont.info.fontAscent - PCF_FontGetStringMaxInkAscentLen(font, str, len);
 }
 
 /**
@@ -625,29 +1129,40 @@ Uint32 PCF_FontGetStringTopInkOffset(PCF_Font *font, const char *str)
  */
 void PCF_FontGetSizeRequest(PCF_Font *font, const char *str, bool tight, Uint32 *w, Uint32 *h)
 {
-    int len;
+    PCF_FontGetSizeRequestLen(font, str, strlen(str), tight, w, h);
+}
+
+/**
+ * Same as PCF_FontGetSizeRequest, for the first @p len bytes of @p str
+ * which doesn't need to be NUL-terminated.
+ *
+ * @param str The string whose size you need to know.
+ * @param len The length of @p str in bytes.
+ * @see PCF_FontGetSizeRequest for the other parameters.
+ */
+void PCF_FontGetSizeRequestLen(PCF_Font *font, const char *str, size_t len, bool tight, Uint32 *w, Uint32 *h)
+{
+    int ascent_max = 0;
+    int descent_max = 0;
+    CharInfoRec *glyph;
+    xCharInfo *ink;
 
-    len = strlen(str);
     if(w)
-        *w = font->xfont.fontPrivate->metrics->metrics.characterWidth * len;
-    if(h){
-        if(tight){
-            int ascent_max = 0;
-            int descent_max = 0;
-
-            BitmapFontRec *bitmapFont;
-            bitmapFont  = font->xfont.fontPrivate;
-            for(int i = 0; i < len; i++){
-                int c = str[i];
-                if(c >= bitmapFont->num_chars) continue;
-                ascent_max = MAX(ascent_max, PCF_FontInkMetrics(font)[c].ascent);
-                descent_max = MAX(descent_max, PCF_FontInkMetrics(font)[c].descent);
-            }
-            *h = ascent_max + descent_max;
-        }else{
-            *h = font->xfont.fontPrivate->metrics->metrics.ascent + font->xfont.fontPrivate->metrics->metrics.descent;
-        }
+        *w = PCF_FontMeasure(font, str, len);
+    if(!h)
+        return;
+    if(!tight){
+        *h = PCF_FontCharHeight(font);
+        return;
+    }
+
+    for(int i = 0; i < len; ){
+        if(!(glyph = PCF_FontGetGlyph(font, next_codepoint(str, len, &i)))) continue;
+        ink = PCF_FontGetGlyphInkMetrics(font, glyph);
+        ascent_max = MAX(ascent_max, ink->ascent);
+        descent_max = MAX(descent_max, ink->descent);
     }
+    *h = ascent_max + descent_max;
 }
 
 
@@ -675,84 +1190,551 @@ void PCF_FontGetSizeRequestRect(PCF_Font *font, const char *str, bool tight, SDL
     rect->h = h;
 }
 
-
 /**
- * Dump a char drawing on stdout using on char per pixel, '#' for lit pixels
- * and '.' for others. Helps with debugging the code. Not public, shoudln't
- * be very useful for regular users.
+ * Does all the work of PCF_FontWrite that only depends on the string:
+ * glyph lookup, glyph positions, size and ink bounds. The result can then
+ * be drawn any number of times, at any location, by PCF_PreparedTextDraw
+ * or PCF_PreparedTextRender which only have to blit the glyphs.
  *
- * @param font The font to work with.
- * @param c    The ascii code of the char to dump. Can use 'a' instead of 97.
+ * The prepared text holds a reference on @p font.
+ *
+ * @param font The font to use. Opened by PCF_OpenFont.
+ * @param str The string to prepare, UTF-8 encoded. Not needed anymore once
+ * this function returns.
+ * @param len The length in bytes of @p str, -1 to compute it.
+ * @param tight If true, the text will be drawn using ink metrics (tight
+ * bounding box) instead of full font metrics, see PCF_FontWrite.
+ * @return A newly allocated PCF_PreparedText to be freed with
+ * PCF_FreePreparedText or NULL on error. Details of the failure can be
+ * retreived with SDL_GetError().
  */
-void PCF_FontDumpGlyph(PCF_Font *font, int c)
+PCF_PreparedText *PCF_FontPrepare(PCF_Font *font, const char *str, int len, bool tight)
 {
-    int w, h;
-    int line_bsize;
+    PCF_PreparedText *rv;
+    PCF_PreparedGlyph *pg;
     CharInfoRec *glyph;
-    BitmapFontRec *bitmapFont;
-
-    bitmapFont  = font->xfont.fontPrivate;
-    printf("Number of chars in font: %d\n",  bitmapFont->num_chars);
-    if(c >= bitmapFont->num_chars){
-        printf("No glyph for char %d\n",c);
-        return;
-    }
-    printf("Index of char in font: %d\n", c);
-    glyph = &bitmapFont->metrics[c];
-
-    w = glyph->metrics.rightSideBearing - glyph->metrics.leftSideBearing;
-    h = glyph->metrics.ascent + glyph->metrics.descent;
-
-    printf("\tleft side bearing: %d\n",glyph->metrics.leftSideBearing);
-    printf("\tright side bearing: %d\n",glyph->metrics.rightSideBearing);
-    printf("\twidth: %d\n",glyph->metrics.characterWidth);
-    printf("\tascent: %d\n",glyph->metrics.ascent);
-    printf("\tdescent: %d\n",glyph->metrics.descent);
-    printf("\tattributes: %d\n",glyph->metrics.attributes);
-
-    printf("Ink metrics:\n");
-    xCharInfo *ink = &bitmapFont->ink_metrics[c];
-    printf("\tleft side bearing: %d\n",ink->leftSideBearing);
-    printf("\tright side bearing: %d\n",ink->rightSideBearing);
-    printf("\twidth: %d\n",ink->characterWidth);
-    printf("\tascent: %d\n",ink->ascent);
-    printf("\tdescent: %d\n",ink->descent);
-    printf("\tattributes: %d\n",ink->attributes);
+    xCharInfo *ink;
+    size_t nglyphs;
+    int pen, baseline;
+    int x0, y0, x1, y1;
+    Uint32 c;
 
-    /* FontRec.Glyph seems to be the line padding in number of bytes.
-     * byte = 1, short = 2, int = 4
-     * The pcf format has PCF_GLYPH_PAD_INDEX(format)
-     * which indicates if lines are aligned to bytes(1), shorts(2)
-     * or ints(4). pcfReadFont compares that to its glyph param and
-     * re-pad the data to fit the format.
-     * */
-    printf("font->glyph is %d\n", font->xfont.glyph);
-    line_bsize = ceil(w/(font->xfont.glyph * 8.0))*font->xfont.glyph; /*in bytes*/
-    printf("Each glyph line will be %d bytes\n",line_bsize);
+    if(len < 0)
+        len = strlen(str);
 
+    nglyphs = 0;
+    for(int i = 0; i < len; ){
+        if(next_codepoint(str, len, &i) != ' ')
+            nglyphs++;
+    }
 
-    unsigned char *glyph_line;
-    unsigned char byte;
-    glyph_line = (unsigned char*)glyph->bits;
-    for(int i = 0; i < h; i++){
-        glyph_line = (unsigned char*)glyph->bits + (i * line_bsize);
-        int nbytes = ceil(w/(8.0));
-        for(int j = 0; j < nbytes; j++){
-            byte = *(unsigned char*)(glyph_line + j);
-            for(int k = 0; k < 8; k++){
-                printf("%c", (byte & (1 << k)) ? '#': '.');
-            }
+    rv = SDL_calloc(1, sizeof(PCF_PreparedText) + nglyphs * sizeof(PCF_PreparedGlyph));
+    if(!rv){
+        SDL_SetError("%s: Couldn't allocate memory for %zu glyphs", __FUNCTION__, nglyphs);
+        return NULL;
+    }
+    rv->font = PCF_FontRef(font);
+    rv->tight = tight;
+    rv->glyphs = (PCF_PreparedGlyph *)(rv + 1);
+    PCF_FontGetSizeRequestLen(font, str, len, tight, &rv->w, &rv->h);
+    rv->ink_ascent = PCF_FontGetStringMaxInkAscentLen(font, str, len);
+    baseline = font->xfont.info.fontAscent;
+    if(tight)
+        baseline = rv->ink_ascent;
+
+    x0 = y0 = SDL_MAX_SINT32;
+    x1 = y1 = SDL_MIN_SINT32;
+    pen = 0;
+    for(int i = 0; i < len; ){
+        c = next_codepoint(str, len, &i);
+        if(c == ' '){
+            pen += PCF_FontGetAdvance(font, c);
+            continue;
         }
-        printf("\n");
+        glyph = PCF_FontGetGlyph(font, c);
+        if(!glyph){
+            glyph = font->xfont.fontPrivate->pDefault;
+            PCF_STATS_INC(default_glyphs);
+        }
+        if(!glyph){
+            pen += PCF_FontGetAdvance(font, c);
+            continue;
+        }
+        pg = &rv->glyphs[rv->nglyphs++];
+        pg->glyph = glyph;
+        pg->x = pen + glyph->metrics.leftSideBearing;
+        pg->y = baseline - glyph->metrics.ascent;
+
+        ink = PCF_FontGetGlyphInkMetrics(font, glyph);
+        if(ink->rightSideBearing > ink->leftSideBearing && ink->ascent + ink->descent > 0){
+            x0 = MIN(x0, pen + ink->leftSideBearing);
+            x1 = MAX(x1, pen + ink->rightSideBearing);
+            y0 = MIN(y0, baseline - ink->ascent);
+            y1 = MAX(y1, baseline + ink->descent);
+        }
+        pen += glyph->metrics.characterWidth;
     }
-    printf("\n");
-}
+    if(x0 < x1)
+        rv->ink = (SDL_Rect){x0, y0, x1 - x0, y1 - y0};
 
+    return rv;
+}
 
 /**
- * Creates and return a pre-drawn set of characters.
- * The font can be closed afterwards. The return value must be freed by the
- * caller using PCF_FreeStaticFont().
+ * Releases a prepared text and its reference on the font.
+ *
+ * @param self The prepared text to free.
+ */
+void PCF_FreePreparedText(PCF_PreparedText *self)
+{
+    PCF_CloseFont(self->font);
+    SDL_free(self);
+}
+
+/**
+ * Writes a prepared text on a surface, with the top-left corner of the
+ * text at @p x, @p y. Same output as PCF_FontWrite at that location.
+ *
+ * @param self The text to write, see PCF_FontPrepare.
+ * @param color The color of text. Must be in @p destination format (use
+ * SDL_MapRGB/SDL_MapRGBA to build a suitable value).
+ * @param destination The surface to write to.
+ * @param x Where to write on the surface.
+ * @param y Where to write on the surface.
+ * @return True on success(the whole text has been written), false on error/partial
+ * draw. Details of the failure can be retreived with SDL_GetError().
+ */
+bool PCF_PreparedTextDraw(PCF_PreparedText *self, Uint32 color, SDL_Surface *destination, int x, int y)
+{
+    bool rv;
+    PCF_PreparedGlyph *pg;
+
+    PCF_TRACE_BEGIN("PCF_PreparedTextDraw", self->font);
+    rv = true;
+    PCF_STATS_ADD(glyphs_written, self->nglyphs);
+    for(size_t i = 0; i < self->nglyphs; i++){
+        pg = &self->glyphs[i];
+        if(!PCF_FontDrawGlyph(self->font, pg->glyph, color, destination, x + pg->x, y + pg->y))
+            rv = false;
+    }
+    PCF_TRACE_END("PCF_PreparedTextDraw", self->font);
+    return rv;
+}
+
+/**
+ * Same as PCF_PreparedTextDraw, placing the text relatively to @p col and
+ * @p row like PCF_FontWriteAt does. No need to measure the text again.
+ *
+ * @param self The text to write, see PCF_FontPrepare.
+ * @param color @see PCF_PreparedTextDraw
+ * @param destination @see PCF_PreparedTextDraw
+ * @param col The column to write relative to, see @p placement
+ * @param row The line to write relative to, see @p placement
+ * @param placement @see PCF_FontWriteAt
+ * @return @see PCF_FontWriteAt
+ */
+bool PCF_PreparedTextDrawAt(PCF_PreparedText *self, Uint32 color, SDL_Surface *destination,
+                            Uint32 col, Uint32 row, PCF_TextPlacement placement)
+{
+    SDL_Rect cursor = (SDL_Rect){0, 0, 0 ,0};
+
+    if(!PCF_FontPlace(self->font, self->w, self->h, self->ink_ascent, col, row, placement, &cursor))
+        return false;
+    return PCF_PreparedTextDraw(self, color, destination, cursor.x, cursor.y);
+}
+
+/**
+ * Same as PCF_PreparedTextDraw, on a SDL_Renderer. Same output as
+ * PCF_FontRender at that location.
+ *
+ * @param self The text to write, see PCF_FontPrepare.
+ * @param color The color of text. If not NULL, it will overrede the current
+ * renderer's color. If NULL, the current renderer's color will be used.
+ * @param renderer The rendering context to use.
+ * @param x Where to write on the renderer.
+ * @param y Where to write on the renderer.
+ * @return True on success(the whole text has been written), false on error/partial
+ * draw. Details of the failure can be retreived with SDL_GetError().
+ */
+bool PCF_PreparedTextRender(PCF_PreparedText *self, SDL_Color *color, SDL_Renderer *renderer, int x, int y)
+{
+    bool rv;
+    PCF_PreparedGlyph *pg;
+
+    if(color){
+        SDL_SetRenderDrawColor(renderer, color->r, color->g, color->b, color->a);
+        PCF_STATS_INC(renderer_calls);
+    }
+
+    PCF_TRACE_BEGIN("PCF_PreparedTextRender", self->font);
+    rv = true;
+    PCF_STATS_ADD(glyphs_rendered, self->nglyphs);
+    for(size_t i = 0; i < self->nglyphs; i++){
+        pg = &self->glyphs[i];
+        if(!PCF_FontRenderGlyph(self->font, pg->glyph, renderer, x + pg->x, y + pg->y))
+            rv = false;
+    }
+    PCF_TRACE_END("PCF_PreparedTextRender", self->font);
+    return rv;
+}
+
+/**
+ * Creates a fixed-width numeric field, for values that are updated
+ * often but usually only change by a few digits (counters, readouts).
+ * Each char of the number gets its own cell and PCF_NumberDisplayUpdate
+ * only repaints the cells that changed, background included: no need
+ * to clear the field beforehand.
+ *
+ * Cells are as wide as the widest advance among digits, '-', '.' and
+ * ',' for the glyphs to stay put while the value changes, even with
+ * proportional fonts (glyphs are then centered in their cell).
+ *
+ * The display holds a reference on @p font.
+ *
+ * @param font The font to use. Opened by PCF_OpenFont.
+ * @param x Top-left corner of the field on the destination surface.
+ * @param y Top-left corner of the field on the destination surface.
+ * @param width Size of the field in chars, numbers are right-aligned in it.
+ * @param type @see PCF_FontWriteNumber
+ * @param precision @see PCF_FontWriteNumber
+ * @return A newly allocated PCF_NumberDisplay to be freed with
+ * PCF_FreeNumberDisplay or NULL on error. Details of the failure can be
+ * retreived with SDL_GetError().
+ */
+PCF_NumberDisplay *PCF_CreateNumberDisplay(PCF_Font *font, int x, int y, Uint8 width, PCF_NumberType type, int8_t precision)
+{
+    PCF_NumberDisplay *rv;
+    const char *chars = "0123456789-.,";
+
+    if(!width){
+        SDL_SetError("%s: Can't create a 0 chars wide field", __FUNCTION__);
+        return NULL;
+    }
+
+    rv = SDL_calloc(1, sizeof(PCF_NumberDisplay) + width);
+    if(!rv){
+        SDL_SetError("%s: Couldn't allocate memory for %d cells", __FUNCTION__, width);
+        return NULL;
+    }
+    rv->font = PCF_FontRef(font);
+    rv->type = type;
+    rv->precision = precision;
+    rv->ncells = width;
+    rv->cells = (char *)(rv + 1);
+
+    for(int i = 0; chars[i]; i++)
+        rv->cell_w = MAX(rv->cell_w, PCF_FontGetAdvance(font, chars[i]));
+    rv->location = (SDL_Rect){x, y, rv->cell_w * width, PCF_FontCharHeight(font)};
+
+    return rv;
+}
+
+/**
+ * Releases a numeric field and its reference on the font. The field is
+ * left as is on the surface.
+ *
+ * @param self The display to free.
+ */
+void PCF_FreeNumberDisplay(PCF_NumberDisplay *self)
+{
+    PCF_CloseFont(self->font);
+    SDL_free(self);
+}
+
+/**
+ * Forgets what the field shows, for the next PCF_NumberDisplayUpdate to
+ * repaint all cells. To be called when the destination surface gets
+ * cleared or drawn over.
+ *
+ * @param self The display whose cells are now stale.
+ */
+void PCF_NumberDisplayInvalidate(PCF_NumberDisplay *self)
+{
+    SDL_memset(self->cells, '\0', self->ncells);
+}
+
+/**
+ * Shows @p value in the field, repainting only the cells whose char
+ * changed since the last update. Cells get filled with @p background
+ * before the glyph is drawn. All cells are repainted on the first update,
+ * after PCF_NumberDisplayInvalidate and when colors change.
+ *
+ * @param self The field to update, see PCF_CreateNumberDisplay.
+ * @param value Pointer to the value to show, of the type given to
+ * PCF_CreateNumberDisplay.
+ * @param color The color of text. Must be in @p destination format (use
+ * SDL_MapRGB/SDL_MapRGBA to build a suitable value).
+ * @param background The color of the cells, same format as @p color.
+ * @param destination The surface to write to. Must be the same across
+ * updates, unless the display has been invalidated.
+ * @param dirty If not NULL, will be set to the area actually repainted,
+ * 0x0 at the field location if nothing changed. Suitable for
+ * SDL_UpdateWindowSurfaceRects.
+ * @return True on success, false if the number couldn't be formatted or
+ * doesn't fit in the field (the field is then left untouched) or on
+ * (partial) drawing error. Details of the failure can be retreived with
+ * SDL_GetError().
+ */
+bool PCF_NumberDisplayUpdate(PCF_NumberDisplay *self, void *value, Uint32 color, Uint32 background,
+                             SDL_Surface *destination, SDL_Rect *dirty)
+{
+    char buffer[PCF_NUMBER_BUFFER_SIZE];
+    char *str;
+    int len, pad;
+    int first, last;
+    SDL_Rect cell;
+    CharInfoRec *glyph;
+    char c;
+    bool rv;
+
+    if(dirty)
+        *dirty = (SDL_Rect){self->location.x, self->location.y, 0, 0};
+
+    str = number_format(value, self->type, self->precision, buffer);
+    if(!str)
+        return false;
+    len = strlen(str);
+    if(len > self->ncells){
+        SDL_SetError("%s: %s doesn't fit in %d cells", __FUNCTION__, str, self->ncells);
+        return false;
+    }
+
+    if(color != self->color || background != self->background){
+        PCF_NumberDisplayInvalidate(self);
+        self->color = color;
+        self->background = background;
+    }
+
+    rv = true;
+    first = -1;
+    last = -1;
+    pad = self->ncells - len;
+    cell = (SDL_Rect){self->location.x, self->location.y, self->cell_w, self->location.h};
+    for(int i = 0; i < self->ncells; i++, cell.x += self->cell_w){
+        c = (i < pad) ? ' ' : str[i - pad];
+        if(self->cells[i] == c)
+            continue;
+        self->cells[i] = c;
+        if(first < 0)
+            first = i;
+        last = i;
+
+        SDL_FillRect(destination, &cell, background);
+        if(c == ' ')
+            continue;
+        glyph = PCF_FontGetGlyph(self->font, c);
+        if(!glyph){
+            glyph = self->font->xfont.fontPrivate->pDefault;
+            PCF_STATS_INC(default_glyphs);
+        }
+        if(!glyph)
+            continue;
+        PCF_STATS_INC(glyphs_written);
+        if(!PCF_FontDrawGlyph(self->font, glyph, color, destination,
+                              cell.x + (self->cell_w - glyph->metrics.characterWidth)/2
+                                     + glyph->metrics.leftSideBearing,
+                              cell.y + self->font->xfont.info.fontAscent - glyph->metrics.ascent))
+            rv = false;
+    }
+
+    if(dirty && first >= 0){
+        dirty->x += first * self->cell_w;
+        dirty->w = (last - first + 1) * self->cell_w;
+        dirty->h = self->location.h;
+    }
+    return rv;
+}
+
+
+/**
+ * Computes the memory allocated for @p font, broken down by use. Helps
+ * budgeting fonts: that's what a font costs while it's open.
+ *
+ * @param font The font, opened by PCF_OpenFont.
+ * @param out Where to store the breakdown. Can be NULL to only get the total.
+ * atlas and textures are always 0 for a PCF_Font.
+ * @return The total in bytes, same as out->total.
+ */
+size_t PCF_FontGetMemoryUsage(PCF_Font *font, PCF_MemUsage *out)
+{
+    PCF_MemUsage usage = {0};
+    BitmapFontRec *bitmapFont;
+    FontInfoRec *info;
+    xCharInfo *m;
+    int nencoding, pad;
+
+    bitmapFont = font->xfont.fontPrivate;
+    info = &font->xfont.info;
+
+    usage.other = sizeof(PCF_Font) + sizeof(BitmapFontRec);
+    usage.properties = info->nprops * (sizeof(FontPropRec) + sizeof(char));
+    usage.metrics = bitmapFont->num_chars * sizeof(CharInfoRec);
+    if(bitmapFont->ink_metrics)
+        usage.ink_metrics = bitmapFont->num_chars * sizeof(xCharInfo);
+
+    /*Bitmap lines are padded to xfont.glyph bytes, see pcfReadFont*/
+    pad = font->xfont.glyph * 8;
+    for(int i = 0; i < bitmapFont->num_chars; i++){
+        m = &bitmapFont->metrics[i].metrics;
+        usage.bitmaps += (m->ascent + m->descent)
+            * ((m->rightSideBearing - m->leftSideBearing + pad - 1) / pad) * font->xfont.glyph;
+    }
+
+    nencoding = (info->lastCol - info->firstCol + 1) * (info->lastRow - info->firstRow + 1);
+    usage.encoding = NUM_SEGMENTS(nencoding) * sizeof(CharInfoRec **);
+    for(int i = 0; i < NUM_SEGMENTS(nencoding); i++){
+        if(bitmapFont->encoding[i])
+            usage.encoding += BITMAP_FONT_SEGMENT_SIZE * sizeof(CharInfoRec *);
+    }
+
+    usage.total = usage.metrics + usage.ink_metrics + usage.encoding
+                + usage.bitmaps + usage.properties + usage.other;
+    if(out)
+        *out = usage;
+    return usage.total;
+}
+
+/**
+ * Gets the counters updated by the library since the program started or
+ * the last PCF_ResetStats. Only available when the library has been
+ * configured with --enable-stats (PCF_HAVE_STATS is then 1): counting
+ * is otherwise compiled out. Counters are global and not thread-safe,
+ * like the rest of the library.
+ *
+ * @param out Where to copy the counters. Zeroed when statistics aren't
+ * available.
+ * @return true on success, false when the library has been built without
+ * statistics. Details of the failure can be retreived with SDL_GetError().
+ */
+bool PCF_GetStats(PCF_Stats *out)
+{
+#if PCF_HAVE_STATS
+    *out = pcf_stats;
+    return true;
+#else
+    SDL_memset(out, 0, sizeof(PCF_Stats));
+    SDL_SetError("%s: statistics not built in, configure with --enable-stats", __FUNCTION__);
+    return false;
+#endif
+}
+
+/**
+ * Sets all counters returned by PCF_GetStats back to 0, e.g. at the
+ * start of each frame. Does nothing when the library has been built
+ * without statistics.
+ */
+void PCF_ResetStats(void)
+{
+#if PCF_HAVE_STATS
+    SDL_memset(&pcf_stats, 0, sizeof(PCF_Stats));
+#endif
+}
+
+/**
+ * Sets functions to be called when the library begins and ends an
+ * operation: opening a font and each of its table, writing or rendering a
+ * string, creating a static font or an atlas, uploading textures. This
+ * lets profilers (Tracy zones, perf markers, ...) attribute time to
+ * font operations and to fonts.
+ *
+ * Calls are properly nested: @p end is called for each @p begin, in
+ * reverse order. Operation names are string literals, e.g "PCF_OpenFont",
+ * "PCF_OpenFont/bitmaps" or "PCF_FontWrite". Hooks are global: set them
+ * before using fonts, not while an operation is in progress.
+ *
+ * @param begin Called with the operation name and the object it works on:
+ * the PCF_Font, or the PCF_StaticFont for PCF_StaticFont* operations, or
+ * the PCF_AtlasBuilder for PCF_AtlasBuilderBuild. Can be NULL.
+ * @param end Called when the operation is done, with the same parameters.
+ * Can be NULL.
+ * @param userdata Passed as is to @p begin and @p end.
+ */
+void PCF_SetTraceHooks(PCF_TraceFunc begin, PCF_TraceFunc end, void *userdata)
+{
+    pcf_trace = (PCF_TraceHooks){
+        .begin = begin,
+        .end = end,
+        .userdata = userdata
+    };
+}
+
+/**
+ * Dump a char drawing on stdout using on char per pixel, '#' for lit pixels
+ * and '.' for others. Helps with debugging the code. Not public, shoudln't
+ * be very useful for regular users.
+ *
+ * @param font The font to work with.
+ * @param c    The Unicode codepoint of the char to dump. Can use 'a' instead of 97.
+ */
+void PCF_FontDumpGlyph(PCF_Font *font, int c)
+{
+    int w, h;
+    int line_bsize;
+    CharInfoRec *glyph;
+    BitmapFontRec *bitmapFont;
+
+    bitmapFont  = font->xfont.fontPrivate;
+    printf("Number of chars in font: %d\n",  bitmapFont->num_chars);
+    glyph = (c >= 0) ? PCF_FontGetGlyph(font, c) : NULL;
+    if(!glyph){
+        printf("No glyph for char %d\n",c);
+        return;
+    }
+    printf("Index of char in font: %d\n", (int)(glyph - bitmapFont->metrics));
+
+    w = glyph->metrics.rightSideBearing - glyph->metrics.leftSideBearing;
+    h = glyph->metrics.ascent + glyph->metrics.descent;
+
+    printf("\tleft side bearing: %d\n",glyph->metrics.leftSideBearing);
+    printf("\tright side bearing: %d\n",glyph->metrics.rightSideBearing);
+    printf("\twidth: %d\n",glyph->metrics.characterWidth);
+    printf("\tascent: %d\n",glyph->metrics.ascent);
+    printf("\tdescent: %d\n",glyph->metrics.descent);
+    printf("\tattributes: %d\n",glyph->metrics.attributes);
+
+    printf("Ink metrics:\n");
+    xCharInfo *ink = PCF_FontGetGlyphInkMetrics(font, glyph);
+    printf("\tleft side bearing: %d\n",ink->leftSideBearing);
+    printf("\tright side bearing: %d\n",ink->rightSideBearing);
+    printf("\twidth: %d\n",ink->characterWidth);
+    printf("\tascent: %d\n",ink->ascent);
+    printf("\tdescent: %d\n",ink->descent);
+    printf("\tattributes: %d\n",ink->attributes);
+
+    /* FontRec.Glyph seems to be the line padding in number of bytes.
+     * byte = 1, short = 2, int = 4
+     * The pcf format has PCF_GLYPH_PAD_INDEX(format)
+     * which indicates if lines are aligned to bytes(1), shorts(2)
+     * or ints(4). pcfReadFont compares that to its glyph param and
+     * re-pad the data to fit the format.
+     * */
+    printf("font->glyph is %d\n", font->xfont.glyph);
+    line_bsize = ceil(w/(font->xfont.glyph * 8.0))*font->xfont.glyph; /*in bytes*/
+    printf("Each glyph line will be %d bytes\n",line_bsize);
+
+
+    unsigned char *glyph_line;
+    unsigned char byte;
+    glyph_line = (unsigned char*)glyph->bits;
+    for(int i = 0; i < h; i++){
+        glyph_line = (unsigned char*)glyph->bits + (i * line_bsize);
+        int nbytes = ceil(w/(8.0));
+        for(int j = 0; j < nbytes; j++){
+            byte = *(unsigned char*)(glyph_line + j);
+            for(int k = 0; k < 8; k++){
+                printf("%c", (byte & (1 << k)) ? '#': '.');
+            }
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+
+/**
+ * Creates and return a pre-drawn set of characters.
+ * The font can be closed afterwards. The return value must be freed by the
+ * caller using PCF_FreeStaticFont().
  *
  * Once drawn, static fonts are immutable: You can't add characters on the fly,
  * or change colors. You'll need to create a new static font to do that. The
@@ -762,574 +1744,2833 @@ void PCF_FontDumpGlyph(PCF_Font *font, int c)
  * @param font  The font to draw with
  * @param color The color of the pre-rendered glyphs
  * @param nsets The number of glyph sets that follows
- * @param ...   Sets of glyphs to include in the cache, as const char*. You can
- * use pre-defined sets such as PCF_ALPHA, PCF_DIGIT, etc. The function will
- * filter out duplicated characters.
+ * @param ...   Sets of glyphs to include in the cache, as UTF-8 encoded
+ * const char*. You can use pre-defined sets such as PCF_ALPHA, PCF_DIGIT, etc.
+ * The function will filter out duplicated characters. Bytes that are not part
+ * of a valid UTF-8 sequence are taken as Latin-1 chars.
  * @returns a newly allocated PCF_StaticFont or NULL on error. The error will be
  * available with SDL_GetError()
  *
  */
-PCF_StaticFont *PCF_FontCreateStaticFont(PCF_Font *font, SDL_Color *color, int nsets, ...)
+PCF_StaticFont *PCF_FontCreateStaticFont(PCF_Font *font, SDL_Color *color, int nsets, ...)
+{
+    va_list ap;
+    char *tmp;
+    size_t tlen;
+    PCF_StaticFont *rv;
+
+    tlen = 0;
+    va_start(ap, nsets);
+    for(int i = 0; i < nsets; i++){
+        tmp = va_arg(ap, char*);
+        tlen += strlen(tmp);
+    }
+    va_end(ap);
+
+    va_start(ap, nsets);
+    rv = PCF_FontCreateStaticFontWithOptionsVA(font, color, NULL, nsets, tlen, ap);
+    va_end(ap);
+
+    return rv;
+}
+
+/**
+ * va_list version of PCF_FontCreateStaticFont. The only difference is that
+ * this function needs to be provided with the total(cumulative) length of
+ * all the strings that it gets through ap. This is due to the fact that
+ * va_list can't be rewinded when passed as an argument to a non-variadic
+ * function
+ *
+ * @param font See PCF_FontCreateStaticFont @param font
+ * @param color See PCF_FontCreateStaticFont @param color
+ * @param nsets See PCF_FontCreateStaticFont @param nsets
+ * @param tlen Total (cumulative) len of the strings passed in.
+ * @param ap List of @param nsets char*
+ * @return See PCF_FontCreateStaticFont @return.
+ */
+PCF_StaticFont *PCF_FontCreateStaticFontVA(PCF_Font *font, SDL_Color *color, int nsets, size_t tlen, va_list ap)
+{
+    return PCF_FontCreateStaticFontWithOptionsVA(font, color, NULL, nsets, tlen, ap);
+}
+
+/**
+ * Same as PCF_FontCreateStaticFont, with control over how the glyphs are
+ * laid out in the atlas.
+ *
+ * Glyphs are packed in a near-square grid. When the grid doesn't fit in
+ * the maximum page size, the remaining glyphs go to additional pages:
+ * see PCF_StaticFont.pages and PCF_StaticFontPatch.page.
+ *
+ * @param font See PCF_FontCreateStaticFont @param font
+ * @param color See PCF_FontCreateStaticFont @param color
+ * @param options Creation options, NULL to use the defaults. Zeroed
+ * members also get their default value.
+ * @param nsets See PCF_FontCreateStaticFont @param nsets
+ * @param ... See PCF_FontCreateStaticFont @param ...
+ * @return See PCF_FontCreateStaticFont @return.
+ */
+PCF_StaticFont *PCF_FontCreateStaticFontWithOptions(PCF_Font *font, SDL_Color *color, PCF_StaticFontOptions *options, int nsets, ...)
+{
+    va_list ap;
+    char *tmp;
+    size_t tlen;
+    PCF_StaticFont *rv;
+
+    tlen = 0;
+    va_start(ap, nsets);
+    for(int i = 0; i < nsets; i++){
+        tmp = va_arg(ap, char*);
+        tlen += strlen(tmp);
+    }
+    va_end(ap);
+
+    va_start(ap, nsets);
+    rv = PCF_FontCreateStaticFontWithOptionsVA(font, color, options, nsets, tlen, ap);
+    va_end(ap);
+
+    return rv;
+}
+
+#if USE_SDL2_TEXTURE
+/**
+ * Sets the maximum page size of @p options to the maximum texture size
+ * supported by @p renderer. Atlases created with these options will always
+ * be usable with that renderer.
+ *
+ * @param options The options to update.
+ * @param renderer The renderer that will be used to draw the static font.
+ * @return false if the renderer couldn't be queried (SDL_GetError will
+ * give details), true otherwise.
+ */
+bool PCF_StaticFontOptionsFromRenderer(PCF_StaticFontOptions *options, SDL_Renderer *renderer)
+{
+    SDL_RendererInfo info;
+
+    if(SDL_GetRendererInfo(renderer, &info) != 0)
+        return false;
+    /*0 means the renderer has no known limit, leave the default*/
+    if(info.max_texture_width > 0)
+        options->max_page_width = info.max_texture_width;
+    if(info.max_texture_height > 0)
+        options->max_page_height = info.max_texture_height;
+    return true;
+}
+#endif
+
+
+/*
+ * Creates an empty (transparent) atlas page of @p w x @p h pixels.
+ * AtlasIndex8 pages get the @p ncolors first entries of @p palette,
+ * entry 0 being the colorkeyed background.
+ */
+static SDL_Surface *PCF_StaticFontCreatePage(int w, int h, PCF_AtlasFormat format, SDL_Color *palette, int ncolors)
+{
+    SDL_Surface *rv;
+
+    if(format == AtlasIndex8){
+        rv = SDL_CreateRGBSurfaceWithFormat(0, w, h, 8, SDL_PIXELFORMAT_INDEX8);
+        if(!rv)
+            return NULL;
+        if(ncolors)
+            SDL_SetPaletteColors(rv->format->palette, palette, 0, ncolors);
+        SDL_SetColorKey(rv, SDL_TRUE, 0);
+    }else{
+        rv = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_RGBA32);
+    }
+    return rv;
+}
+
+/*
+ * Palette of a standalone AtlasIndex8 static font: background,
+ * text_color then effect_color. Returns the number of entries.
+ */
+static int PCF_StaticFontGetPalette(PCF_StaticFont *self, SDL_Color palette[3])
+{
+    palette[0] = self->text_color;
+    palette[0].a = SDL_ALPHA_TRANSPARENT;
+    palette[self->palette_index] = self->text_color;
+    if(self->effect == EffectNone)
+        return 2;
+    palette[self->effect_palette_index] = self->effect_color;
+    return 3;
+}
+
+/*
+ * Width of the cell of glyph @p i, effects included.
+ */
+static inline int PCF_StaticFontGlyphCellWidth(PCF_StaticFont *self, int i)
+{
+    if(!self->glyph_widths)
+        return PCF_StaticFontCellWidth(self);
+    return self->glyph_widths[i].width + self->margin.left + self->margin.right;
+}
+
+/*
+ * Location of atlas slot @p slot. Slots are numbered row by row, page by
+ * page: The first page holds slots 0 to page_cols * page_rows - 1, etc.
+ */
+static PCF_AtlasCell PCF_StaticFontSlotCell(PCF_StaticFont *self, int slot)
+{
+    int per_page;
+    int j;
+
+    per_page = self->page_cols * self->page_rows;
+    j = slot % per_page;
+    return (PCF_AtlasCell){
+        .src = (SDL_Rect){
+            .x = (j % self->page_cols) * PCF_StaticFontCellWidth(self),
+            .y = (j / self->page_cols) * PCF_StaticFontCellHeight(self),
+            .w = PCF_StaticFontCellWidth(self),
+            .h = PCF_StaticFontCellHeight(self)
+        },
+        .page = slot / per_page
+    };
+}
+
+/*
+ * Makes sure that atlas pages are large enough to hold @p nslots slots,
+ * adding pages or growing the last one as needed. Pages are only as high
+ * as the rows they hold, growing pages double their height to avoid
+ * having to do it for each glyph.
+ *
+ * A page that gets reallocated loses its texture, which will have to be
+ * created again.
+ */
+static bool PCF_StaticFontReserveSlots(PCF_StaticFont *self, int nslots)
+{
+    int per_page, npages;
+    int cell_w, cell_h;
+
+    cell_w = PCF_StaticFontCellWidth(self);
+    cell_h = PCF_StaticFontCellHeight(self);
+    per_page = self->page_cols * self->page_rows;
+    npages = (nslots + per_page - 1) / per_page;
+    if(npages > UINT8_MAX){
+        SDL_SetError("%s: %d glyphs need more than %d atlas pages",
+            __FUNCTION__, nslots, UINT8_MAX
+        );
+        return false;
+    }
+
+    if(npages > self->npages){
+        SDL_Surface **pages;
+
+        pages = SDL_realloc(self->pages, npages * sizeof(SDL_Surface*));
+        if(!pages){
+            SDL_SetError("Couldn't allocate memory for PCF_StaticFont pages\n");
+            return false;
+        }
+        memset(pages + self->npages, 0, (npages - self->npages) * sizeof(SDL_Surface*));
+        self->pages = pages;
+        if(self->textures){
+            PCF_AtlasTexture **textures;
+
+            textures = SDL_realloc(self->textures, npages * sizeof(*textures));
+            if(!textures){
+                SDL_SetError("Couldn't allocate memory for PCF_StaticFont textures\n");
+                return false;
+            }
+            memset(textures + self->npages, 0, (npages - self->npages) * sizeof(*textures));
+            self->textures = textures;
+        }
+        self->npages = npages;
+    }
+
+    for(int i = 0; i < npages; i++){
+        SDL_Surface *page;
+        int rows, current;
+
+        /*Last page only takes the rows it needs*/
+        rows = (i < npages - 1) ? self->page_rows : (nslots - i * per_page + self->page_cols - 1) / self->page_cols;
+        current = self->pages[i] ? self->pages[i]->h / cell_h : 0;
+        if(rows <= current)
+            continue;
+        if(current)
+            rows = SDL_max(rows, SDL_min(self->page_rows, current * 2));
+
+        SDL_Color palette[3];
+        page = PCF_StaticFontCreatePage(self->page_cols * cell_w, rows * cell_h, self->format,
+                                        palette, PCF_StaticFontGetPalette(self, palette));
+        if(!page)
+            return false;
+        if(self->pages[i]){
+            /*Same width and format, rows can be copied over as they are*/
+            memcpy(page->pixels, self->pages[i]->pixels, self->pages[i]->pitch * self->pages[i]->h);
+            SDL_FreeSurface(self->pages[i]);
+            if(self->textures && self->textures[i]){
+#if USE_SDL2_TEXTURE
+                SDL_DestroyTexture(self->textures[i]);
+#elif USE_SGPU_TEXTURE
+                GPU_FreeImage(self->textures[i]);
+#endif
+                self->textures[i] = NULL;
+            }
+        }
+        self->pages[i] = page;
+    }
+    self->raster = self->pages[0];
+    if(self->textures)
+        self->texture = self->textures[0];
+
+    return true;
+}
+
+/*
+ * Lays out @p ncells cells in a near-square grid, spilling over additional
+ * pages when the grid doesn't fit in @p max_w x @p max_h. Allocates
+ * self->pages, room is made for @p nspare more cells.
+ */
+static bool PCF_StaticFontLayoutPages(PCF_StaticFont *self, int ncells, int nspare, int max_w, int max_h)
+{
+    int cols;
+    int cell_w, cell_h;
+
+    cell_w = PCF_StaticFontCellWidth(self);
+    cell_h = PCF_StaticFontCellHeight(self);
+    if(cell_w > max_w || cell_h > max_h){
+        SDL_SetError("%s: %dx%d glyphs don't fit in %dx%d atlas pages",
+            __FUNCTION__, cell_w, cell_h, max_w, max_h
+        );
+        return false;
+    }
+
+    /* Near-square in pixels: cols * cell_w ~= rows * cell_h with
+     * rows = ncells / cols*/
+    ncells += nspare;
+    cols = SDL_ceil(SDL_sqrt(ncells * cell_h / (double)cell_w));
+    cols = SDL_max(1, SDL_min(cols, ncells));
+    cols = SDL_min(cols, max_w / cell_w);
+    self->page_cols = cols;
+    self->page_rows = SDL_min(max_h / cell_h, UINT16_MAX);
+
+    return PCF_StaticFontReserveSlots(self, ncells);
+}
+
+/*Where the next cell goes, see PCF_StaticFontPackCells*/
+typedef struct{
+    int page_w;
+    int max_h;
+    int x, y;
+    int shelf_h;
+    int page;
+    int *page_heights; /*UINT8_MAX + 1 entries*/
+}ShelfPacker;
+
+/*
+ * Widest cell of @p self and total area of its cells, the default
+ * glyph included.
+ */
+static void PCF_StaticFontCellsExtent(PCF_StaticFont *self, int *widest, int *area)
+{
+    int w;
+
+    *widest = *area = 0;
+    for(int i = 0; i <= self->nglyphs; i++){
+        w = PCF_StaticFontGlyphCellWidth(self, i);
+        *widest = SDL_max(*widest, w);
+        *area += w * PCF_StaticFontCellHeight(self);
+    }
+}
+
+/*
+ * Places the cells of @p self, the default glyph included, on the shelves
+ * (rows) of @p packer pages. A new shelf is started when the current one is
+ * full and a new page when the current page is.
+ */
+static bool PCF_StaticFontPackCells(PCF_StaticFont *self, ShelfPacker *packer)
+{
+    int w, h;
+
+    h = PCF_StaticFontCellHeight(self);
+    for(int i = 0; i <= self->nglyphs; i++){
+        w = PCF_StaticFontGlyphCellWidth(self, i);
+        if(packer->x + w > packer->page_w){
+            packer->x = 0;
+            packer->y += packer->shelf_h;
+            packer->shelf_h = 0;
+        }
+        if(packer->y + h > packer->max_h){
+            if(++packer->page > UINT8_MAX){
+                SDL_SetError("%s: glyphs need more than %d atlas pages", __FUNCTION__, UINT8_MAX);
+                return false;
+            }
+            packer->x = packer->y = packer->shelf_h = 0;
+        }
+        self->cells[i] = (PCF_AtlasCell){
+            .src = (SDL_Rect){packer->x, packer->y, w, h},
+            .page = packer->page
+        };
+        packer->x += w;
+        packer->shelf_h = SDL_max(packer->shelf_h, h);
+        packer->page_heights[packer->page] = SDL_max(packer->page_heights[packer->page], packer->y + h);
+    }
+    return true;
+}
+
+/*
+ * Packs glyphs of proportional fonts by their actual width in
+ * near-square pages of at most @p max_w x @p max_h. Allocates
+ * self->pages. Unlike slots (see PCF_StaticFontLayoutPages), there is
+ * no room left to add glyphs afterwards.
+ */
+static bool PCF_StaticFontPackPages(PCF_StaticFont *self, int max_w, int max_h)
+{
+    ShelfPacker packer = {0};
+    SDL_Color palette[3];
+    int widest, area, ncolors;
+    bool rv;
+
+    PCF_StaticFontCellsExtent(self, &widest, &area);
+    if(widest > max_w || PCF_StaticFontCellHeight(self) > max_h){
+        SDL_SetError("%s: %dx%d glyphs don't fit in %dx%d atlas pages",
+            __FUNCTION__, widest, PCF_StaticFontCellHeight(self), max_w, max_h
+        );
+        return false;
+    }
+    packer.page_w = SDL_max(widest, SDL_min(max_w, (int)SDL_ceil(SDL_sqrt(area))));
+    packer.max_h = max_h;
+    packer.page_heights = SDL_calloc(UINT8_MAX + 1, sizeof(int));
+    if(!packer.page_heights){
+        SDL_SetError("Couldn't allocate memory for PCF_StaticFont layout\n");
+        return false;
+    }
+
+    rv = false;
+    if(!PCF_StaticFontPackCells(self, &packer))
+        goto end;
+    self->npages = packer.page + 1;
+    self->pages = SDL_calloc(self->npages, sizeof(SDL_Surface*));
+    if(!self->pages){
+        SDL_SetError("Couldn't allocate memory for PCF_StaticFont pages\n");
+        goto end;
+    }
+    ncolors = PCF_StaticFontGetPalette(self, palette);
+    for(int i = 0; i < self->npages; i++){
+        self->pages[i] = PCF_StaticFontCreatePage(packer.page_w, packer.page_heights[i], self->format,
+                                                  palette, ncolors);
+        if(!self->pages[i])
+            goto end;
+    }
+    self->raster = self->pages[0];
+    rv = true;
+end:
+    SDL_free(packer.page_heights);
+    return rv;
+}
+
+/*
+ * Draws glyph @p i of @p self in its cell, along with its effect if
+ * any, and records its ink heights. @p i == self->nglyphs is the
+ * implicit default glyph.
+ */
+static void PCF_StaticFontRasterizeGlyph(PCF_StaticFont *self, PCF_Font *font, int i)
+{
+    CharInfoRec *glyph;
+    xCharInfo *ink;
+    SDL_Surface *page;
+    Uint32 col;
+    int x, y;
+
+    glyph = (i < self->nglyphs) ? PCF_FontGetGlyph(font, self->glyphs[i]) : NULL;
+    if(!glyph){ /*Missing glyphs and the implicit last one*/
+        glyph = font->xfont.fontPrivate->pDefault;
+        if(i < self->nglyphs)
+            PCF_STATS_INC(default_glyphs);
+    }
+    if(!glyph)
+        return;
+
+    if(i < self->nglyphs){
+        ink = PCF_FontGetGlyphInkMetrics(font, glyph);
+        self->glyph_heights[i] = (InkHeight){
+            .ascent = ink->ascent * self->scale,
+            .descent = ink->descent * self->scale
+        };
+        if(self->glyphs[i] == ' ')
+            return;
+    }
+
+    /* Cells of proportional fonts start where the bitmap does, monospace
+     * ones at the pen position*/
+    page = self->pages[self->cells[i].page];
+    x = self->cells[i].src.x + self->margin.left;
+    if(!self->glyph_widths)
+        x += glyph->metrics.leftSideBearing * self->scale;
+    y = self->cells[i].src.y + self->margin.top + (font->xfont.info.fontAscent - glyph->metrics.ascent) * self->scale;
+
+    /*Effects go below the glyph itself*/
+    if(self->effect != EffectNone){
+        if(self->format == AtlasIndex8)
+            col = self->effect_palette_index;
+        else
+            col = SDL_MapRGBA(page->format,
+                self->effect_color.r, self->effect_color.g, self->effect_color.b, self->effect_color.a
+            );
+        if(self->effect == EffectOutline){
+            for(int dy = -1; dy <= 1; dy++){
+                for(int dx = -1; dx <= 1; dx++){
+                    if(dx || dy)
+                        PCF_FontDrawGlyphScaled(font, glyph, col, page, x + dx * self->scale, y + dy * self->scale, self->scale);
+                }
+            }
+        }else{
+            PCF_FontDrawGlyphScaled(font, glyph, col, page,
+                x + self->shadow_dx * self->scale, y + self->shadow_dy * self->scale, self->scale
+            );
+        }
+    }
+
+    if(self->format == AtlasIndex8)
+        col = self->palette_index;
+    else
+        col =  SDL_MapRGBA(page->format,
+            self->text_color.r, self->text_color.g, self->text_color.b, self->text_color.a
+        );
+    PCF_FontDrawGlyphScaled(font, glyph, col, page, x, y, self->scale);
+    PCF_STATS_INC(glyphs_baked);
+}
+
+/*
+ * Scales the metrics of @p self, 0 meaning 1.
+ */
+static bool PCF_StaticFontSetScale(PCF_StaticFont *self, int scale)
+{
+    if(scale < 0 || scale > PCF_STATIC_FONT_MAX_SCALE){
+        SDL_SetError("%s: unsupported scale factor %d, max is %d", __FUNCTION__, scale, PCF_STATIC_FONT_MAX_SCALE);
+        return false;
+    }
+    self->scale = scale ? scale : 1;
+    self->metrics.leftSideBearing *= self->scale;
+    self->metrics.rightSideBearing *= self->scale;
+    self->metrics.characterWidth *= self->scale;
+    self->metrics.ascent *= self->scale;
+    self->metrics.descent *= self->scale;
+    return true;
+}
+
+/*
+ * Sets up the effect and cell margins of @p self from @p options.
+ * self->scale must be set.
+ */
+static bool PCF_StaticFontSetEffect(PCF_StaticFont *self, PCF_StaticFontOptions *options)
+{
+    int dx, dy;
+
+    self->effect = options->effect;
+    self->effect_color = options->effect_color;
+    self->effect_palette_index = 2;
+    switch(options->effect){
+        case EffectNone:
+            break;
+        case EffectOutline:
+            self->margin = (PCF_CellMargin){1, 1, 1, 1};
+            break;
+        case EffectShadow:
+            dx = options->shadow_offset.x;
+            dy = options->shadow_offset.y;
+            if(!dx && !dy)
+                dx = dy = 1;
+            if(dx < INT8_MIN || dx > INT8_MAX || dy < INT8_MIN || dy > INT8_MAX){
+                SDL_SetError("%s: shadow offset %d,%d out of range", __FUNCTION__, dx, dy);
+                return false;
+            }
+            self->shadow_dx = dx;
+            self->shadow_dy = dy;
+            self->margin = (PCF_CellMargin){
+                .left = SDL_max(0, -dx),
+                .top = SDL_max(0, -dy),
+                .right = SDL_max(0, dx),
+                .bottom = SDL_max(0, dy)
+            };
+            break;
+        default:
+            SDL_SetError("%s: unknown glyph effect %d", __FUNCTION__, options->effect);
+            return false;
+    }
+    self->margin.left *= self->scale;
+    self->margin.top *= self->scale;
+    self->margin.right *= self->scale;
+    self->margin.bottom *= self->scale;
+    return true;
+}
+
+/*
+ * Records the horizontal metrics of the glyphs of @p self, for proportional
+ * fonts. self->scale must be set.
+ */
+static bool PCF_StaticFontInitWidths(PCF_StaticFont *self, PCF_Font *font)
+{
+    CharInfoRec *glyph;
+
+    self->glyph_widths = SDL_calloc(self->nglyphs + 1, sizeof(GlyphWidth));
+    if(!self->glyph_widths){
+        SDL_SetError("Couldn't allocate memory for PCF_StaticFont glyph widths\n");
+        return false;
+    }
+    for(int i = 0; i <= self->nglyphs; i++){
+        glyph = (i < self->nglyphs) ? PCF_FontGetGlyph(font, self->glyphs[i]) : NULL;
+        if(!glyph && (i == self->nglyphs || self->glyphs[i] != ' '))
+            glyph = font->xfont.fontPrivate->pDefault;
+        if(!glyph){
+            self->glyph_widths[i].advance = PCF_FontCharWidth(font) * self->scale;
+            continue;
+        }
+        self->glyph_widths[i] = (GlyphWidth){
+            .bearing = glyph->metrics.leftSideBearing * self->scale,
+            .width = (glyph->metrics.rightSideBearing - glyph->metrics.leftSideBearing) * self->scale,
+            .advance = glyph->metrics.characterWidth * self->scale
+        };
+    }
+    return true;
+}
+
+/*
+ * Allocates a static font holding the glyphs of the @p nsets sets in
+ * @p ap, along with its glyph index. Atlas pages are left to the caller.
+ */
+static PCF_StaticFont *PCF_StaticFontNew(PCF_Font *font, SDL_Color *color, PCF_StaticFontOptions *options,
+                                         int nsets, size_t tlen, va_list ap)
+{
+    PCF_StaticFont *rv;
+    const char *tmp;
+    size_t len, nglyphs;
+
+    rv = SDL_calloc(1, sizeof(PCF_StaticFont));
+    if(!rv){
+        SDL_SetError("Couldn't allocate memory for new PCF_StaticFont\n");
+        return NULL;
+    }
+
+    /*There can't be more codepoints than bytes*/
+    rv->glyphs = SDL_calloc(tlen + 1, sizeof(Uint32));
+    if(!rv->glyphs){
+        SDL_SetError("Couldn't allocate memory for PCF_StaticFont glyphs\n");
+        goto bail;
+    }
+
+    nglyphs = 0;
+    for(int i = 0; i < nsets; i++){
+        tmp = va_arg(ap, const char*);
+        len = strlen(tmp);
+        for(size_t j = 0; j < len; nglyphs++)
+            j += utf8_decode(tmp + j, len - j, &rv->glyphs[nglyphs]);
+    }
+
+    qsort(rv->glyphs, nglyphs, sizeof(Uint32), compare_codepoints);
+    nglyphs = filter_dedup(rv->glyphs, nglyphs);
+    if(nglyphs >= UINT16_MAX){
+        SDL_SetError("%s: too many glyphs (%zu), max is %d", __FUNCTION__, nglyphs, UINT16_MAX - 1);
+        goto bail;
+    }
+    rv->nglyphs = nglyphs;
+
+    rv->glyph_heights = SDL_calloc(rv->nglyphs, sizeof(InkHeight));
+    /*The static font will hold an implicit default glyph at it's very end*/
+    rv->cells = SDL_calloc(rv->nglyphs + 1, sizeof(PCF_AtlasCell));
+    if(!rv->glyph_heights || !rv->cells){
+        SDL_SetError("Couldn't allocate memory for PCF_StaticFont glyph data\n");
+        goto bail;
+    }
+
+    for(int i = 0; i < rv->nglyphs; i++){
+        if(!PCF_StaticFontIndexGlyph(rv, rv->glyphs[i], i))
+            goto bail;
+    }
+
+    rv->metrics = font->xfont.fontPrivate->metrics->metrics;
+    rv->metrics.characterWidth = PCF_FontCharWidth(font);
+    rv->metrics.ascent = font->xfont.info.fontAscent;
+    rv->metrics.descent = font->xfont.info.fontDescent;
+    rv->text_color = *color;
+    rv->palette_index = 1;
+    rv->scale = 1;
+    if(options){
+        rv->format = options->format;
+        if(!PCF_StaticFontSetScale(rv, options->scale))
+            goto bail;
+        if(!PCF_StaticFontSetEffect(rv, options))
+            goto bail;
+    }
+    if(!font->monospace && !PCF_StaticFontInitWidths(rv, font))
+        goto bail;
+
+    return rv;
+bail:
+    PCF_FreeStaticFont(rv);
+    return NULL;
+}
+
+/*
+ * PCF_FontCreateStaticFontWithOptionsVA, without tracing.
+ */
+static PCF_StaticFont *PCF_StaticFontCreate(PCF_Font *font, SDL_Color *color, PCF_StaticFontOptions *options,
+                                            int nsets, size_t tlen, va_list ap)
+{
+    PCF_StaticFont *rv;
+    int max_w, max_h;
+
+    max_w = (options && options->max_page_width > 0) ? options->max_page_width : PCF_STATIC_FONT_PAGE_SIZE;
+    max_h = (options && options->max_page_height > 0) ? options->max_page_height : PCF_STATIC_FONT_PAGE_SIZE;
+
+    rv = PCF_StaticFontNew(font, color, options, nsets, tlen, ap);
+    if(!rv)
+        return NULL;
+
+    if(rv->glyph_widths){
+        if(!PCF_StaticFontPackPages(rv, max_w, max_h))
+            goto bail;
+    }else{
+        if(!PCF_StaticFontLayoutPages(rv, rv->nglyphs + 1, options ? options->spare_glyphs : 0, max_w, max_h))
+            goto bail;
+        for(int i = 0; i <= rv->nglyphs; i++)
+            rv->cells[i] = PCF_StaticFontSlotCell(rv, i);
+    }
+
+    for(int i = 0; i <= rv->nglyphs; i++)
+        PCF_StaticFontRasterizeGlyph(rv, font, i);
+
+    return rv;
+bail:
+    PCF_FreeStaticFont(rv);
+    return NULL;
+}
+
+/**
+ * va_list version of PCF_FontCreateStaticFontWithOptions, see
+ * PCF_FontCreateStaticFontVA.
+ *
+ * @param font See PCF_FontCreateStaticFont @param font
+ * @param color See PCF_FontCreateStaticFont @param color
+ * @param options See PCF_FontCreateStaticFontWithOptions @param options
+ * @param nsets See PCF_FontCreateStaticFont @param nsets
+ * @param tlen Total (cumulative) len of the strings passed in.
+ * @param ap List of @param nsets char*
+ * @return See PCF_FontCreateStaticFont @return.
+ */
+PCF_StaticFont *PCF_FontCreateStaticFontWithOptionsVA(PCF_Font *font, SDL_Color *color, PCF_StaticFontOptions *options,
+                                                      int nsets, size_t tlen, va_list ap)
+{
+    PCF_StaticFont *rv;
+
+    PCF_TRACE_BEGIN("PCF_FontCreateStaticFont", font);
+    rv = PCF_StaticFontCreate(font, color, options, nsets, tlen, ap);
+    PCF_TRACE_END("PCF_FontCreateStaticFont", font);
+    return rv;
+}
+
+/*
+ * Frees atlas pages along with their textures.
+ */
+static void PCF_FreeAtlasPages(int npages, SDL_Surface **pages, PCF_AtlasTexture **textures)
+{
+    for(int i = 0; i < npages; i++){
+        if(pages)
+            SDL_FreeSurface(pages[i]);
+        if(textures){
+#if USE_SDL2_TEXTURE
+            SDL_DestroyTexture(textures[i]);
+#elif USE_SGPU_TEXTURE
+            GPU_FreeImage(textures[i]);
+#endif
+        }
+    }
+    SDL_free(pages);
+    SDL_free(textures);
+}
+
+/**
+ * Frees memory used by a static font. Each static font created using
+ * PCF_FontCreateStaticFont should be released using this function.
+ *
+ * @param self The PCF_StaticFont to free.
+ */
+void PCF_FreeStaticFont(PCF_StaticFont *self)
+{
+    if(self->refcnt <= 0){
+        SDL_free(self->glyphs);
+        SDL_free(self->glyph_heights);
+        SDL_free(self->cells);
+        SDL_free(self->glyph_widths);
+        for(int i = 0; i < self->index_rows; i++)
+            SDL_free(self->index[i]);
+        SDL_free(self->index);
+        if(self->shared)
+            PCF_SharedAtlasUnref(self->shared);
+        else
+            PCF_FreeAtlasPages(self->npages, self->pages, self->textures);
+        SDL_free(self);
+    }else{
+        self->refcnt--;
+    }
+}
+
+/**
+ * Same as PCF_FontGetMemoryUsage for a static font. Static fonts made by a
+ * PCF_AtlasBuilder share their atlas pages and textures: each of them
+ * counts the whole shared atlas.
+ *
+ * @param font The static font.
+ * @param out Where to store the breakdown. Can be NULL to only get the total.
+ * ink_metrics, bitmaps and properties are always 0 for a PCF_StaticFont.
+ * textures is 0 until PCF_StaticFontCreateTexture is called.
+ * @return The total in bytes, same as out->total.
+ */
+size_t PCF_StaticFontGetMemoryUsage(PCF_StaticFont *font, PCF_MemUsage *out)
+{
+    PCF_MemUsage usage = {0};
+
+    usage.other = sizeof(PCF_StaticFont) + font->npages * sizeof(SDL_Surface*);
+    usage.metrics = font->nglyphs * sizeof(InkHeight) + (font->nglyphs + 1) * sizeof(PCF_AtlasCell);
+    if(font->glyph_widths)
+        usage.metrics += (font->nglyphs + 1) * sizeof(GlyphWidth);
+    usage.encoding = font->nglyphs * sizeof(Uint32) + font->index_rows * sizeof(Uint16*);
+    for(int i = 0; i < font->index_rows; i++){
+        if(font->index[i])
+            usage.encoding += 256 * sizeof(Uint16);
+    }
+
+    for(int i = 0; i < font->npages; i++){
+        if(font->pages[i])
+            usage.atlas += font->pages[i]->h * font->pages[i]->pitch;
+    }
+
+    if(font->textures){
+        usage.other += font->npages * sizeof(PCF_AtlasTexture*);
+        for(int i = 0; i < font->npages; i++){
+            if(!font->textures[i])
+                continue;
+#if USE_SDL2_TEXTURE
+            Uint32 format;
+            int w, h;
+
+            if(SDL_QueryTexture(font->textures[i], &format, NULL, &w, &h) == 0)
+                usage.textures += w * h * SDL_BYTESPERPIXEL(format);
+#elif USE_SGPU_TEXTURE
+            usage.textures += font->textures[i]->texture_w * font->textures[i]->texture_h
+                            * font->textures[i]->bytes_per_pixel;
+#endif
+        }
+    }
+
+    usage.total = usage.metrics + usage.encoding + usage.atlas + usage.textures + usage.other;
+    if(out)
+        *out = usage;
+    return usage.total;
+}
+
+/**
+ * Finds the index of a given codepoint. Internal use only. Not counted
+ * in the stats, lookups of glyphs that get drawn go through
+ * PCF_StaticFontCountLookup.
+ *
+ * @param font The static font to search in.
+ * @param c    The codepoint to search for.
+ *
+ * @return the index or negative if not found
+ */
+static inline int PCF_StaticFontGetGlyphIndex(PCF_StaticFont *font, Uint32 c)
+{
+    Uint16 *row;
+
+    if((c >> 8) >= font->index_rows || !(row = font->index[c >> 8]) || !row[c & 0xff])
+        return -1;
+    return row[c & 0xff] - 1;
+}
+
+/*
+ * Counts a glyph about to be drawn as a static font hit, or as a miss
+ * when @p i (as returned by PCF_StaticFontGetGlyphIndex) says the
+ * default glyph will be drawn instead.
+ */
+static inline void PCF_StaticFontCountLookup(int i)
+{
+    if(i < 0)
+        PCF_STATS_INC(static_misses);
+    else
+        PCF_STATS_INC(static_hits);
+}
+
+/*
+ * Records that glyph @p i of @p font is the one for @p c, allocating the
+ * second-level table if needed.
+ */
+static bool PCF_StaticFontIndexGlyph(PCF_StaticFont *font, Uint32 c, int i)
+{
+    Uint16 **row;
+
+    if(c > 0x10ffff){
+        SDL_SetError("%s: codepoint %u out of range", __FUNCTION__, c);
+        return false;
+    }
+    if((c >> 8) >= font->index_rows){
+        Uint16 **index;
+        Uint16 nrows;
+
+        nrows = (c >> 8) + 1;
+        index = SDL_realloc(font->index, nrows * sizeof(Uint16*));
+        if(!index){
+            SDL_SetError("Couldn't allocate memory for PCF_StaticFont index\n");
+            return false;
+        }
+        memset(index + font->index_rows, 0, (nrows - font->index_rows) * sizeof(Uint16*));
+        font->index = index;
+        font->index_rows = nrows;
+    }
+    row = &font->index[c >> 8];
+    if(!*row){
+        *row = SDL_calloc(256, sizeof(Uint16));
+        if(!*row){
+            SDL_SetError("Couldn't allocate memory for PCF_StaticFont index\n");
+            return false;
+        }
+    }
+    (*row)[c & 0xff] = i + 1;
+    return true;
+}
+
+/**
+ * Find the atlas page and the area within that page holding a glyph for c.
+ * The area is suitable for a SDL_BlitSurface or a SDL_RenderCopy operation
+ * using self->pages[cell->page] or self->textures[cell->page] as a source.
+ *
+ * @param font The static font to search in.
+ * @param c    The Unicode codepoint to search for.
+ * @param cell Location where to put the page and coordinates, when found.
+ * @return 0 for whitespace (@p cell untouched), non-zero if @param font
+ * has something printable for @param c: 1 if the char as been found,
+ * -1 otherwise. When returning -1, cell has been set to the default glyph.
+ */
+int PCF_StaticFontGetCharCell(PCF_StaticFont *font, Uint32 c, PCF_AtlasCell *cell)
+{
+    int i;
+    int rv;
+
+    if(c == ' ')
+        return 0;
+
+    rv = 1;
+    i = PCF_StaticFontGetGlyphIndex(font, c);
+    PCF_StaticFontCountLookup(i);
+    if(i < 0){
+        rv = SDL_SetError("%s: U+%04X: glpyh not found in font %p",__FUNCTION__, c, font);
+        /*make i point to the implicit default char*/
+        i = font->nglyphs;
+    }
+    *cell = font->cells[i];
+
+    return rv;
+}
+
+/*
+ * Same as PCF_StaticFontGetCharCell minus the error reporting, for the
+ * pre-write loops: returns NULL for whitespace, the default glyph cell
+ * for missing chars.
+ */
+static inline PCF_AtlasCell *PCF_StaticFontLookupCell(PCF_StaticFont *font, Uint32 c)
+{
+    int i;
+
+    if(c == ' ')
+        return NULL;
+    i = PCF_StaticFontGetGlyphIndex(font, c);
+    PCF_StaticFontCountLookup(i);
+    return &font->cells[i < 0 ? font->nglyphs : i];
+}
+
+/*
+ * Index of the glyph drawn for @p c, that of the default glyph for
+ * missing chars. For the pre-write loops: spaces aren't drawn and
+ * aren't counted, their index is only used for their advance.
+ */
+static inline int PCF_StaticFontLookupIndex(PCF_StaticFont *font, Uint32 c)
+{
+    int i;
+
+    i = PCF_StaticFontGetGlyphIndex(font, c);
+    if(c != ' ')
+        PCF_StaticFontCountLookup(i);
+    return i < 0 ? font->nglyphs : i;
+}
+
+/*
+ * Horizontal advance of Unicode codepoint @p c. With proportional fonts,
+ * chars missing from the static font (spaces included) advance like the
+ * default glyph. Internal use only.
+ */
+static inline int PCF_StaticFontGetAdvance(PCF_StaticFont *font, Uint32 c)
+{
+    int i;
+
+    if(!font->glyph_widths)
+        return PCF_StaticFontCharWidth(font);
+    i = PCF_StaticFontGetGlyphIndex(font, c);
+    return font->glyph_widths[i < 0 ? font->nglyphs : i].advance;
+}
+
+/*
+ * AdvanceGetter for PCF_StaticFont.
+ */
+static int static_font_advance(void *font, Uint32 c)
+{
+    return PCF_StaticFontGetAdvance(font, c);
+}
+
+/*
+ * Width in pixels of the first @p len bytes of @p str, see PCF_FontMeasure.
+ */
+static int PCF_StaticFontMeasure(PCF_StaticFont *font, const char *str, int len)
+{
+    int rv, i;
+
+    rv = 0;
+    if(!font->glyph_widths){
+        for(i = 0; i < len; rv++)
+            next_codepoint(str, len, &i);
+        return rv * PCF_StaticFontCharWidth(font);
+    }
+    for(i = 0; i < len; )
+        rv += PCF_StaticFontGetAdvance(font, next_codepoint(str, len, &i));
+    return rv;
+}
+
+
+/**
+ * Find the area in self->raster holding a glyph for c. The area is
+ * suitable for a SDL_BlitSurface or a SDL_RenderCopy operation using
+ * self->raster as a source.
+ *
+ * Only meaningful when all glyphs fit in a single page (font->npages == 1),
+ * use PCF_StaticFontGetCharCell otherwise.
+ *
+ * @param font The static font to search in.
+ * @param c    The Unicode codepoint to search for.
+ * @param glyph Location where to put the coordinates, when found.
+ * @return 0 for whitespace (@glpyh untouched), non-zero if @param font
+ * has something printable for @param c: 1 if the char as been found,
+ * -1 otherwise. When returning -1, glpyh has been set to the default glyph.
+ */
+int PCF_StaticFontGetCharRect(PCF_StaticFont *font, Uint32 c, SDL_Rect *glyph)
+{
+    PCF_AtlasCell cell;
+    int rv;
+
+    rv = PCF_StaticFontGetCharCell(font, c, &cell);
+    if(rv != 0)
+        *glyph = cell.src;
+    return rv;
+}
+
+/**
+ * Computes space (pixels width*height) needed to draw a string using a given
+ * font. Both @param w and @param h can be NULL depending on which metric you
+ * are interested in. The function won't fail if both are NULL, it'll just be
+ * useless.
+ *
+ * @param str The string whose size you need to know.
+ * @param tight If true, the rendering will use ink metrics (tight bounding box)
+ * instead of full font metrics. This trims empty space above and below the text.
+ * @param font The font you want to use to write that string
+ * @param w Pointer to somewhere to place the resulting width. Can be NULL.
+ * @param h Pointer to somewhere to place the resulting height. Can be NULL.
+ *
+ */
+void PCF_StaticFontGetSizeRequest(PCF_StaticFont *font, const char *str, bool tight, Uint32 *w, Uint32 *h)
+{
+    PCF_StaticFontGetSizeRequestLen(font, str, strlen(str), tight, w, h);
+}
+
+/**
+ * Same as PCF_StaticFontGetSizeRequest, for the first @p len bytes of
+ * @p str which doesn't need to be NUL-terminated.
+ *
+ * @param str The string whose size you need to know.
+ * @param len The length of @p str in bytes.
+ * @see PCF_StaticFontGetSizeRequest for the other parameters.
+ */
+void PCF_StaticFontGetSizeRequestLen(PCF_StaticFont *font, const char *str, size_t len, bool tight, Uint32 *w, Uint32 *h)
+{
+    int ascent_max = 0;
+    int descent_max = 0;
+    Uint32 c;
+
+    for(size_t i = 0; tight && h && i < len; ){
+        i += utf8_decode(str + i, len - i, &c);
+        int glyph_index = PCF_StaticFontGetGlyphIndex(font, c);
+        if(glyph_index < 0) continue;
+        ascent_max = MAX(ascent_max, font->glyph_heights[glyph_index].ascent);
+        descent_max = MAX(descent_max, font->glyph_heights[glyph_index].descent);
+    }
+
+    if(w)
+        *w = PCF_StaticFontMeasure(font, str, len);
+    if(h){
+        if(tight)
+            *h = ascent_max + descent_max;
+        else
+            *h = font->metrics.ascent + font->metrics.descent;
+    }
+}
+
+/**
+ * Same PCF_StaticFontGetSizeRequest as but fills an SDL_Rect. Rect x and y
+ * get initialized to 0.
+ *
+ * @param str The string whose size you need to know.
+ * @param tight If true, the rendering will use ink metrics (tight bounding box)
+ * instead of full font metrics. This trims empty space above and below the text.
+ * @param font The font you want to use to write that string
+ * @param rect Pointer to an existing SDL_Rect (cannot be NULL) to fill with
+ * the size request.
+ */
+void PCF_StaticFontGetSizeRequestRect(PCF_StaticFont *font, const char *str, bool tight, SDL_Rect *rect)
+{
+    Uint32 w, h;
+
+    PCF_StaticFontGetSizeRequest(font, str, tight, &w, &h);
+
+    rect->x = 0;
+    rect->y = 0;
+    rect->w = w;
+    rect->h = h;
+}
+
+/**
+ * @see PCF_FontGetStringMaxInkAscent
+ *
+ * @param font The font you want to use to write that string
+ * @param str The string to write.
+ *
+ * @returns the height
+ */
+Uint32 PCF_StaticFontGetStringMaxInkAscent(PCF_StaticFont *font, const char *str)
+{
+    return PCF_StaticFontGetStringMaxInkAscentLen(font, str, strlen(str));
+}
+
+/**
+ * @see PCF_FontGetStringMaxInkAscentLen
+ *
+ * @param font The font you want to use to write that string
+ * @param str The string to write.
+ * @param len The length of @p str in bytes.
+ *
+ * @returns the height
+ */
+Uint32 PCF_StaticFontGetStringMaxInkAscentLen(PCF_StaticFont *font, const char *str, size_t len)
+{
+    int rv;
+    Uint32 c;
+
+    rv = 0;
+    for(size_t i = 0; i < len; ){
+        i += utf8_decode(str + i, len - i, &c);
+        int glyph_index = PCF_StaticFontGetGlyphIndex(font, c);
+        if(glyph_index < 0) continue;
+        rv = MAX(rv, font->glyph_heights[glyph_index].ascent);
+    }
+    return rv;
+}
+
+/**
+ * See PCF_FontGetStringTopInkOffset.
+ *
+ * @param font The font you want to use to write that string
+ * @param str The string to write.
+ *
+ * @returns the offset
+ */
+Uint32 PCF_StaticFontGetStringTopInkOffset(PCF_StaticFont *font, const char *str)
+{
+    return font->metrics.ascent - PCF_StaticFontGetStringMaxInkAscent(font, str);
+}
+
+/**
+ * See PCF_FontGetStringTopInkOffsetLen.
+ *
+ * @param font The font you want to use to write that string
+ * @param str The string to write.
+ * @param len The length of @p str in bytes.
+ *
+ * @returns the offset
+ */
+Uint32 PCF_StaticFontGetStringTopInkOffsetLen(PCF_StaticFont *font, const char *str, size_t len)
+{
+    return font->metrics.ascent - PCF_StaticFontGetStringMaxInkAscentLen(font, str, len);
+}
+
+
+/**
+ * @brief Generate a set of areas to blit from/to in order to write @p str using @p font
+ *
+ * This function will generate up to @p npatches char patches at location @p patches. Each
+ * patch has two top-left corners of font widthxheight rectangles one being the source (blit from
+ * @p font->raster or @p font->texture) and the other destination (where to blit the char to have
+ * a continuous one-line string). With glyph effects, patches cover the whole
+ * cell: dst is moved up and left by @p font->margin.
+ *
+ * @param font a PCF_StaticFont
+ * @param str the string to write, UTF-8 encoded
+ * @param tight If true, the rendering will use ink metrics (tight bounding box) instead
+ * of full font metrics. This trims empty space above and below the text.
+ * @param len the length in bytes of the string to write, -1 to compute it.
+ * @p location of top-left start position the cursor or NULL to start at 0,0. If not NULL,
+ * this function will advance the location at the end of the string and size it to the maximum
+ * area used by one glyph.
+ * @p npatches size of @p patches. Must be the same size of str (spaces won't output a patch)
+ * @p patches pointer to a large enough array of PCF_StaticFontPatches
+ * @return number of patches actually written
+ */
+size_t PCF_StaticFontPreWriteString(PCF_StaticFont *font, int len, const char *str, bool tight,
+                                    SDL_Rect *location, size_t npatches, PCF_StaticFontPatch *patches)
+{
+    size_t rv;
+    PCF_AtlasCell *glyph;
+    SDL_Rect *cursor;
+    Uint32 offset;
+    int cw, x;
+
+    if(len < 0)
+        len = strlen(str);
+    offset = tight ? PCF_StaticFontGetStringTopInkOffsetLen(font, str, len) : 0;
+
+    cursor = location ? location : &(SDL_Rect){
+        .x = 0,
+        .y = 0
+    };
+    /* We don't use these values in the function but set them for the calling code
+     * to know what we have done
+     */
+    cursor->w = PCF_StaticFontCharWidth(font);
+    cursor->h = PCF_StaticFontCharHeight(font) - offset;
+
+    PCF_TRACE_BEGIN("PCF_StaticFontPreWriteString", font);
+    rv = 0;
+    x = cursor->x;
+    if(font->glyph_widths){
+        for(int i = 0; i < len && rv < npatches; ){
+            Uint32 c = next_codepoint(str, len, &i);
+            int g = PCF_StaticFontLookupIndex(font, c);
+
+            if(c != ' '){
+                glyph = &font->cells[g];
+                patches[rv].src = (SDL_Rect){
+                    glyph->src.x,
+                    glyph->src.y + offset,
+                    glyph->src.w,
+                    glyph->src.h - offset
+                };
+                patches[rv].dst = (SDL_Point){
+                    x + font->glyph_widths[g].bearing - font->margin.left,
+                    cursor->y - font->margin.top
+                };
+                patches[rv].page = glyph->page;
+                rv++;
+            }
+            x += font->glyph_widths[g].advance;
+        }
+        cursor->x = x;
+        PCF_STATS_ADD(glyphs_prewritten, rv);
+        PCF_TRACE_END("PCF_StaticFontPreWriteString", font);
+        return rv;
+    }
+
+    /* Monospace fonts: destination only depends on the column and the
+     * source is a straight table lookup*/
+    cw = PCF_StaticFontCharWidth(font);
+    for(int i = 0; i < len && rv < npatches; x += cw){
+        glyph = PCF_StaticFontLookupCell(font, next_codepoint(str, len, &i));
+        if(!glyph) /*white space*/
+            continue;
+        patches[rv].src = (SDL_Rect){
+            glyph->src.x,
+            glyph->src.y + offset,
+            glyph->src.w,
+            glyph->src.h - offset
+        };
+        patches[rv].dst = (SDL_Point){x - font->margin.left, cursor->y - font->margin.top};
+        patches[rv].page = glyph->page;
+        rv++;
+    }
+    cursor->x = x;
+
+    PCF_STATS_ADD(glyphs_prewritten, rv);
+    PCF_TRACE_END("PCF_StaticFontPreWriteString", font);
+    return rv;
+}
+
+/**
+ * @brief Generate a set of areas to blit from/to in order to write a number
+ * using @p font
+ *
+ * Same as PCF_StaticFontPreWriteString for the number formatted like
+ * PCF_FontWriteNumber does: no string to build in the client code and no
+ * printf nor allocation behind the scenes. PCF_DIGITS has all the chars
+ * that can be needed, along with '-'.
+ *
+ * @param font a PCF_StaticFont
+ * @param value @see PCF_FontWriteNumber
+ * @param type @see PCF_FontWriteNumber
+ * @param precision @see PCF_FontWriteNumber
+ * @param tight @see PCF_StaticFontPreWriteString
+ * @param location @see PCF_StaticFontPreWriteString
+ * @param npatches size of @p patches.
+ * @param patches pointer to a large enough array of PCF_StaticFontPatches
+ * @return number of patches actually written, 0 if the number can't be
+ * formatted. Details of the failure can be retreived with SDL_GetError().
+ */
+size_t PCF_StaticFontPreWriteNumber(PCF_StaticFont *font, void *value, PCF_NumberType type, int8_t precision,
+                                    bool tight, SDL_Rect *location, size_t npatches, PCF_StaticFontPatch *patches)
+{
+    char buffer[PCF_NUMBER_BUFFER_SIZE];
+    char *str;
+
+    str = number_format(value, type, precision, buffer);
+    if(!str)
+        return 0;
+    return PCF_StaticFontPreWriteString(font, -1, str, tight, location, npatches, patches);
+}
+
+/**
+ * @brief Generate a set of areas to blit from/to in order to write @p str
+ * using @p font, with an optional offset.
+ *
+ * This function will generate up to @p npatches char patches at location
+ * @p patches. Each patch has a source SDL_Rect area (blit from  @p font->raster
+ * or @p font->texture) and an SDL_Point that represent the destination origin
+ * where to blit the char to have a continuous one-line string) width and height
+ * are already given in the src member. With glyph effects, patches cover
+ * the whole cell: dst is moved up and left by @p font->margin.
+ *
+ * @param font a PCF_StaticFont
+ * @param str the string to write, UTF-8 encoded
+ * @param tight If true, the rendering will use ink metrics (tight bounding box)
+ * instead of full font metrics. This trims empty space above and below the text.
+ * @param len the length in bytes of the string to write, -1 to compute it.
+ * @param location of top-left start position the cursor or NULL to start at 0,0.
+ * @param xoffset Offset in pixels relative to location. For example a -10 offset
+ * means that the string will be written as if it was moved to the left by 10 pixels.
+ * With a 12px wide font, only the last 2 pixels of the first glyph would be visible.
+ * @param npatches size of @p patches. Must of be the same size as str
+ * (spaces will output a patch with src.x and src.y both set to -1)
+ * @param patches pointer to a large enough array of PCF_StaticFontPartPatches
+ * @return number of patches actually written
+ */
+size_t PCF_StaticFontPreWriteStringOffset(PCF_StaticFont *font,
+                                          int len, const char *str,
+                                          bool tight, SDL_Rect *location,
+                                          int xoffset, int yoffset,
+                                          size_t npatches, PCF_StaticFontPatch *patches)
+{
+    size_t rv;
+    PCF_AtlasCell *glyph;
+    SDL_Rect cursor;
+    Uint32 offset;
+    Uint32 c;
+    int i, g;
+    int pen, cw, right;
+    int top, h, dy;
+
+    if(len < 0)
+        len = strlen(str);
+    offset = tight ? PCF_StaticFontGetStringTopInkOffsetLen(font, str, len) : 0;
+
+    /*Area covered by the cell of the current glyph, effects included*/
+    cursor = (SDL_Rect){
+        .x = 0,
+        .y = (location ? location->y : 0) + yoffset - font->margin.top,
+        .w = PCF_StaticFontCellWidth(font),
+        .h = PCF_StaticFontCellHeight(font)
+    };
+    cursor.h -= offset;
+    pen = (location ? location->x : 0) + xoffset;
+
+    rv = 0;
+
+    /*Monospace fonts: glyphs left of location can be skipped right away*/
+    i = 0;
+    cw = PCF_StaticFontCharWidth(font);
+    if(!font->glyph_widths){
+        int skip = xoffset < -font->margin.right ? (-xoffset - font->margin.right)/cw : 0;
+        pen += skip * cw;
+        for(; skip > 0 && i < len; skip--)
+            i += utf8_decode(str + i, len - i, &c);
+    }
+
+    /* The line is clipped the same way vertically for all glyphs: compute
+     * it once. Horizontally, only the first and the last visible glyphs can
+     * be partially clipped.*/
+    if(cursor.y > SDLExt_RectLastY(location))
+        return 0;
+    top = SDL_max(cursor.y, location->y);
+    h = SDL_max(0, SDL_min(cursor.y + cursor.h, location->y + location->h) - top);
+    dy = 0;
+    if(h < cursor.h){
+        if(cursor.y < location->y)
+            dy = cursor.h - h;
+    }else{
+        h = cursor.h;
+    }
+    right = location->x + location->w;
+
+    PCF_TRACE_BEGIN("PCF_StaticFontPreWriteStringOffset", font);
+    while(i < len && rv < npatches){
+        c = next_codepoint(str, len, &i);
+        if(font->glyph_widths){
+            g = PCF_StaticFontLookupIndex(font, c);
+            glyph = (c == ' ') ? NULL : &font->cells[g];
+            cursor.x = pen + font->glyph_widths[g].bearing - font->margin.left;
+            cursor.w = glyph ? glyph->src.w : font->glyph_widths[g].advance;
+            pen += font->glyph_widths[g].advance;
+            if(cursor.x + cursor.w <= location->x) /*Left of location*/
+                continue;
+        }else{
+            glyph = PCF_StaticFontLookupCell(font, c);
+            cursor.x = pen - font->margin.left;
+            pen += cw;
+        }
+        if(cursor.x >= right)
+            break;
+        if(glyph){
+            patches[rv].src = (SDL_Rect){
+                glyph->src.x,
+                glyph->src.y + offset + dy,
+                glyph->src.w,
+                h
+            };
+            patches[rv].page = glyph->page;
+        }else{ /*white space*/
+            /* We do this to have a patch for spaces that can be used to
+             * show the cursor in SoFIS (see text_box_render() in text-box.c).
+             * in that case we need the dst part to know where on the screen
+             * the space should vs just skipping the patch altogether like in
+             * the non-offset version. PCF_StaticFontCaretRect and
+             * PCF_StaticFontHitTest now give the caret without patches.
+             * TODO: Document and maybe make that configurable in both functions
+             * TODO: Consider having an empty glyph (space) at the beginining of
+             * the string that would simplify the code. At the expense of a couple
+             * of bytes (code is likeyly larger anyways).
+             * */
+            patches[rv].src = (SDL_Rect){-1, -1, cursor.w, h};
+            patches[rv].page = 0;
+        }
+        patches[rv].dst = (SDL_Point){cursor.x, top};
+
+        if(cursor.x < location->x || cursor.x + cursor.w > right){
+            int left = SDL_max(cursor.x, location->x);
+            int w = SDL_min(cursor.x + cursor.w, right) - left;
+
+            /*A negative start point (x,y) means a space. keep it*/
+            if(cursor.x < location->x && patches[rv].src.x >= 0)
+                patches[rv].src.x += cursor.w - w;
+            patches[rv].src.w = w;
+            patches[rv].dst.x = left;
+        }
+        rv++;
+    }
+    PCF_TRACE_END("PCF_StaticFontPreWriteStringOffset", font);
+
+    PCF_STATS_ADD(glyphs_prewritten, rv);
+    return rv;
+}
+
+
+/*
+ * Number of chars (codepoints) in the first @p len bytes of @p str.
+ * Internal use only.
+ */
+static int utf8_length(const char *str, int len)
+{
+    int rv;
+
+    rv = 0;
+    for(int i = 0; i < len; rv++)
+        next_codepoint(str, len, &i);
+    return rv;
+}
+
+/**
+ * @brief Finds the caret position closest to a pixel of a single-line
+ * string written by PCF_StaticFontPreWriteStringOffset
+ *
+ * Only advances are looked at: no patches are generated. With monospace
+ * fonts the position is computed right away, with proportional ones the
+ * string is walked only up to @p x.
+ *
+ * @param font a PCF_StaticFont
+ * @param str the string, UTF-8 encoded
+ * @param len the length in bytes of @p str, -1 to compute it.
+ * @param location Area the string is written in, same as
+ * PCF_StaticFontPreWriteStringOffset.
+ * @param xoffset Horizontal scroll, same as PCF_StaticFontPreWriteStringOffset.
+ * @param x Pixel to test, e.g. where the mouse has been clicked
+ * @param y Pixel to test
+ * @return The index of the char (not byte) before which the caret should go:
+ * 0 before the first char, the number of chars of @p str after the last one.
+ * -1 when @p x, @p y is outside of @p location.
+ */
+int PCF_StaticFontHitTest(PCF_StaticFont *font, const char *str, int len,
+                          SDL_Rect *location, int xoffset, int x, int y)
+{
+    int pen, adv;
+    int i, rv;
+    Uint32 c;
+
+    if(   x < location->x || x > SDLExt_RectLastX(location)
+       || y < location->y || y > SDLExt_RectLastY(location))
+        return -1;
+    if(len < 0)
+        len = strlen(str);
+
+    x -= location->x + xoffset;
+    if(!font->glyph_widths){
+        adv = PCF_StaticFontCharWidth(font);
+        rv = x < 0 ? 0 : (2*x + adv) / (2*adv);
+        i = utf8_length(str, len);
+        return rv < i ? rv : i;
+    }
+
+    pen = 0;
+    rv = 0;
+    for(i = 0; i < len; rv++){
+        c = next_codepoint(str, len, &i);
+        adv = PCF_StaticFontGetAdvance(font, c);
+        if(2*x < 2*pen + adv) /*Left half of the char*/
+            break;
+        pen += adv;
+    }
+    return rv;
+}
+
+/**
+ * @brief Computes where to draw the caret within a single-line string
+ * written by PCF_StaticFontPreWriteStringOffset
+ *
+ * The caret spans the full line height and the advance of the char it is
+ * on (that of a space past the end of the string): use 1 as its width for
+ * a vertical bar. Only advances are looked at, and only up to @p index.
+ *
+ * @param font a PCF_StaticFont
+ * @param str the string, UTF-8 encoded
+ * @param len the length in bytes of @p str, -1 to compute it.
+ * @param location Area the string is written in, same as
+ * PCF_StaticFontPreWriteStringOffset.
+ * @param xoffset Horizontal scroll, same as PCF_StaticFontPreWriteStringOffset.
+ * @param index The index of the char (not byte) the caret is on, see
+ * PCF_StaticFontHitTest. Indexes past the end of the string are taken as
+ * the end of the string.
+ * @param caret Location where to put the caret area.
+ * @return true if the caret is fully within @p location, false if it has
+ * been scrolled out: change @p xoffset to bring it back.
+ */
+bool PCF_StaticFontCaretRect(PCF_StaticFont *font, const char *str, int len,
+                             SDL_Rect *location, int xoffset, int index, SDL_Rect *caret)
+{
+    int pen, adv;
+    int i;
+    Uint32 c;
+
+    if(len < 0)
+        len = strlen(str);
+
+    pen = location->x + xoffset;
+    if(!font->glyph_widths){
+        adv = PCF_StaticFontCharWidth(font);
+        i = utf8_length(str, len);
+        if(index > i)
+            index = i;
+        pen += SDL_max(0, index) * adv;
+    }else{
+        for(i = 0; i < len && index > 0; index--)
+            pen += PCF_StaticFontGetAdvance(font, next_codepoint(str, len, &i));
+        c = (i < len) ? next_codepoint(str, len, &i) : ' ';
+        adv = PCF_StaticFontGetAdvance(font, c);
+    }
+
+    *caret = (SDL_Rect){
+        .x = pen,
+        .y = location->y,
+        .w = adv,
+        .h = PCF_StaticFontCharHeight(font)
+    };
+    return caret->x >= location->x && caret->x + caret->w <= location->x + location->w;
+}
+
+/**
+ * @brief Generates patches to write a multi-line string within @p box,
+ * see PCF_FontWriteBox for the layout rules.
+ *
+ * @param font a PCF_StaticFont
+ * @param len the length in bytes of the string to write, -1 to compute it.
+ * @param str the string to write, UTF-8 encoded
+ * @param box The area to write in.
+ * @param flags See PCF_FontWriteBox
+ * @param npatches size of @p patches.
+ * @param patches where to put the patches, one per char that is not a space.
+ * @param consumed Can be NULL. Otherwise, set to the number of bytes of
+ * @p str that have been laid out: less than @p len if the text doesn't fit
+ * in the box or in @p patches. Lines are kept whole, unless the first one
+ * alone needs more than @p npatches patches: it is then cut after the last
+ * glyph that fits, so that callers going through @p str with a fixed
+ * number of patches always make progress.
+ * @return number of patches actually written, 0 with an error available
+ * through SDL_GetError() if @p npatches is 0 and there is a glyph to write.
+ */
+size_t PCF_StaticFontLayoutBox(PCF_StaticFont *font, int len, const char *str, SDL_Rect *box, PCF_BoxFlags flags,
+                               size_t npatches, PCF_StaticFontPatch *patches, size_t *consumed)
 {
-    va_list ap;
-    char *tmp;
-    size_t tlen;
-    PCF_StaticFont *rv;
+    SDL_Rect cursor;
+    int start, next, end, width;
+    int line_h, line_end;
+    size_t rv, n;
 
-    tlen = 0;
-    va_start(ap, nsets);
-    for(int i = 0; i < nsets; i++){
-        tmp = va_arg(ap, char*);
-        tlen += strlen(tmp);
+    if(len < 0)
+        len = strlen(str);
+    rv = 0;
+    line_h = PCF_StaticFontCharHeight(font);
+    cursor.y = box->y;
+    for(start = 0; start < len && cursor.y + line_h <= box->y + box->h; start = next){
+        next = layout_line(str, len, start, static_font_advance, font, box->w, !(flags & BoxNoWrap), &end, &width);
+        cursor.x = layout_line_x(box, width, flags);
+        line_end = cursor.x + width;
+        n = PCF_StaticFontPreWriteString(font, end - start, str + start, false, &cursor, npatches - rv, patches + rv);
+        /*Patches ran out, the line is incomplete*/
+        if(rv + n == npatches && cursor.x < line_end){
+            if(rv)
+                break;
+            if(!n){
+                SDL_SetError("%s: no room for patches", __FUNCTION__);
+                break;
+            }
+            /*Longer than all the patches: keep its first n glyphs*/
+            rv = n;
+            for(size_t drawn = 0; drawn < n; ){
+                if(next_codepoint(str, len, &start) != ' ')
+                    drawn++;
+            }
+            break;
+        }
+        rv += n;
+        cursor.y += line_h;
     }
-    va_end(ap);
-
-    va_start(ap, nsets);
-    rv = PCF_FontCreateStaticFontVA(font, color, nsets, tlen, ap);
-    va_end(ap);
+    if(consumed)
+        *consumed = start;
 
     return rv;
 }
 
 /**
- * va_list version of PCF_FontCreateStaticFont. The only difference is that
- * this function needs to be provided with the total(cumulative) length of
- * all the strings that it gets through ap. This is due to the fact that
- * va_list can't be rewinded when passed as an argument to a non-variadic
- * function
+ * @brief Same as PCF_StaticFontPreWriteString but writes ready-to-draw
+ * vertices instead of patches.
  *
- * @param font See PCF_FontCreateStaticFont @param font
- * @param color See PCF_FontCreateStaticFont @param color
- * @param nsets See PCF_FontCreateStaticFont @param nsets
- * @param tlen Total (cumulative) len of the strings passed in.
- * @param ap List of @param nsets char*
- * @return See PCF_FontCreateStaticFont @return.
+ * Each glyph that is not a space outputs a quad of 4 vertices (top-left,
+ * top-right, bottom-right, bottom-left) with positions in pixels, texture
+ * coordinates normalized to the size of the glyph page and @p color.
+ * Vertices go straight into @p vertices in the layout given by @p format:
+ * no intermediate patch is needed.
+ *
+ * @param font a PCF_StaticFont
+ * @param len the length in bytes of the string to write, -1 to compute it.
+ * @param str the string to write, UTF-8 encoded
+ * @param tight See PCF_StaticFontPreWriteString
+ * @param location See PCF_StaticFontPreWriteString
+ * @param color Vertex color, NULL for opaque white (i.e leaves the atlas
+ * color untouched when used to modulate it).
+ * @param format VertexFloat to write PCF_VertexF, VertexInt16 to write
+ * PCF_VertexS16.
+ * @param nquads Room in @p vertices, in quads (4 vertices each).
+ * @param vertices Where to write vertices, at least 4 * @p nquads of them.
+ * @param pages Can be NULL. Otherwise, receives the atlas page index of
+ * each quad. Needed only when the font has more than one page.
+ * @return number of quads actually written
  */
-PCF_StaticFont *PCF_FontCreateStaticFontVA(PCF_Font *font, SDL_Color *color, int nsets, size_t tlen, va_list ap)
+size_t PCF_StaticFontPreWriteVertices(PCF_StaticFont *font, int len, const char *str, bool tight,
+                                      SDL_Rect *location, SDL_Color *color, PCF_VertexFormat format,
+                                      size_t nquads, void *vertices, Uint8 *pages)
 {
-    Uint32 w,h;
-    PCF_StaticFont *rv;
-    const char *tmp;
-    char *iter;
-    Uint32 col;
-
-    rv = SDL_calloc(1, sizeof(PCF_StaticFont));
-    if(!rv){
-        SDL_SetError("Couldn't allocate memory for new PCF_StaticFont\n");
-        return NULL;
-    }
+    size_t rv;
+    PCF_AtlasCell glyph;
+    SDL_Rect *cursor;
+    SDL_Color vcolor;
+    Uint32 offset;
+    Uint32 c;
+    int g;
 
-    rv->nglyphs = tlen;
-    rv->glyphs = SDL_calloc(rv->nglyphs + 1, sizeof(char));
-    rv->glyph_heights = SDL_calloc(rv->nglyphs, sizeof(InkHeight));
+    if(len < 0)
+        len = strlen(str);
+    offset = tight ? PCF_StaticFontGetStringTopInkOffsetLen(font, str, len) : 0;
+    vcolor = color ? *color : (SDL_Color){255, 255, 255, 255};
 
-    iter = rv->glyphs;
-    for(int i = 0; i < nsets; i++){
-        tmp = va_arg(ap, const char*);
-        strcpy(iter, tmp);
-        iter += strlen(tmp);
-    }
+    cursor = location ? location : &(SDL_Rect){
+        .x = 0,
+        .y = 0
+    };
+    cursor->w = PCF_StaticFontCharWidth(font);
+    cursor->h = PCF_StaticFontCharHeight(font) - offset;
 
-    PCF_FontGetSizeRequest(font, rv->glyphs, false, &w, &h);
-    /*The static font will hold an implicit default glyph at it's very end*/
-    w += font->xfont.fontPrivate->pDefault->metrics.characterWidth;
-    /*Creates a 32bit surface by default which might be overkill*/
-    rv->raster = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_RGBA32);
-    rv->text_color = *color;
-    col =  SDL_MapRGBA(rv->raster->format, color->r, color->g, color->b, color->a);
-    rv->nglyphs = strlen(rv->glyphs);
-    qsort(rv->glyphs, rv->nglyphs, sizeof(char), (__compar_fn_t) strcmp);
-    filter_dedup(rv->glyphs, rv->nglyphs);
+    PCF_TRACE_BEGIN("PCF_StaticFontPreWriteVertices", font);
+    rv = 0;
+    for(int i = 0; i < len && rv < nquads; ){
+        c = next_codepoint(str, len, &i);
+        g = PCF_StaticFontLookupIndex(font, c);
+        if(c != ' '){
+            SDL_Surface *page;
+            int x0 = cursor->x - font->margin.left;
+
+            glyph = font->cells[g];
+            page = font->pages[glyph.page];
+            if(font->glyph_widths)
+                x0 += font->glyph_widths[g].bearing;
+            int y0 = cursor->y - font->margin.top;
+            int x1 = x0 + glyph.src.w;
+            int y1 = y0 + glyph.src.h - offset;
+            int u0 = glyph.src.x;
+            int v0 = glyph.src.y + offset;
+            int u1 = glyph.src.x + glyph.src.w;
+            int v1 = glyph.src.y + glyph.src.h;
+
+            if(format == VertexInt16){
+                PCF_VertexS16 *q = (PCF_VertexS16*)vertices + rv * 4;
+                Uint16 s0 = u0 * 65535 / page->w, s1 = u1 * 65535 / page->w;
+                Uint16 t0 = v0 * 65535 / page->h, t1 = v1 * 65535 / page->h;
+
+                q[0] = (PCF_VertexS16){x0, y0, s0, t0, vcolor};
+                q[1] = (PCF_VertexS16){x1, y0, s1, t0, vcolor};
+                q[2] = (PCF_VertexS16){x1, y1, s1, t1, vcolor};
+                q[3] = (PCF_VertexS16){x0, y1, s0, t1, vcolor};
+            }else{
+                PCF_VertexF *q = (PCF_VertexF*)vertices + rv * 4;
+                float sw = 1.0f / page->w, sh = 1.0f / page->h;
 
-    rv->metrics = font->xfont.fontPrivate->metrics->metrics;
-    for(int i = 0; i < rv->nglyphs; i++){
-        int c = (unsigned char)rv->glyphs[i];
-        rv->glyph_heights[i] = (InkHeight){
-            .ascent = PCF_FontInkMetrics(font)[c].ascent,
-            .descent = PCF_FontInkMetrics(font)[c].descent
-        };
+                q[0] = (PCF_VertexF){x0, y0, u0 * sw, v0 * sh, vcolor};
+                q[1] = (PCF_VertexF){x1, y0, u1 * sw, v0 * sh, vcolor};
+                q[2] = (PCF_VertexF){x1, y1, u1 * sw, v1 * sh, vcolor};
+                q[3] = (PCF_VertexF){x0, y1, u0 * sw, v1 * sh, vcolor};
+            }
+            if(pages)
+                pages[rv] = glyph.page;
+            rv++;
+        }
+        cursor->x += font->glyph_widths ? font->glyph_widths[g].advance : PCF_StaticFontCharWidth(font);
     }
 
-    PCF_FontWrite(
-        font, rv->glyphs,
-        col, false,
-        rv->raster, NULL
-    );
-    PCF_FontWriteChar(font, -1, col, rv->raster, &(SDL_Rect){
-        .y = 0,
-        .x = rv->raster->w - font->xfont.fontPrivate->pDefault->metrics.characterWidth, /*double checked: ok*/
-        .w = font->xfont.fontPrivate->pDefault->metrics.characterWidth,
-        .h = font->xfont.fontPrivate->pDefault->metrics.ascent + font->xfont.fontPrivate->pDefault->metrics.descent
-    });
-
+    PCF_STATS_ADD(glyphs_prewritten, rv);
+    PCF_TRACE_END("PCF_StaticFontPreWriteVertices", font);
     return rv;
 }
 
+/**
+ * Check whether @param font can be used to write all chars given in
+ * @param sequence in color @param color.
+ *
+ * @param color The color you want to write in. If NULL the function
+ * will assume that the desired color is the same as the font native
+ * color, i.e NULL is equivalent to &font->color.
+ * @param sequence All the chars you may want to use
+ * @return true if all chars of @param sequence can be written in
+ * @param color, false otherwise.
+ */
+bool PCF_StaticFontCanWrite(PCF_StaticFont *font, SDL_Color *color, const char *sequence)
+{
+    size_t len;
+    Uint32 c;
+
+    if(color && memcmp(&font->text_color, color, sizeof(SDL_Color)) != 0){
+        return false;
+    }
+
+    len = strlen(sequence);
+    for(size_t i = 0; i < len; ){
+        i += utf8_decode(sequence + i, len - i, &c);
+        if(PCF_StaticFontGetGlyphIndex(font, c) < 0)
+            return false;
+    }
 
+    return true;
+}
 
+#if USE_SDL2_TEXTURE
 /**
- * Frees memory used by a static font. Each static font created using
- * PCF_FontCreateStaticFont should be released using this function.
+ * Creates a texture for each page of the atlas. textures[i] is made out
+ * of pages[i], texture is the first one.
  *
- * @param self The PCF_StaticFont to free.
+ * @param font The static font.
+ * @param renderer The renderer the textures will be used with.
  */
-void PCF_FreeStaticFont(PCF_StaticFont *self)
+void PCF_StaticFontCreateTexture(PCF_StaticFont *font, SDL_Renderer *renderer)
 {
-    if(self->refcnt <= 0){
-        SDL_free(self->glyphs);
-        SDL_FreeSurface(self->raster);
+    font->renderer = renderer;
+    if(!font->textures)
+        font->textures = SDL_calloc(font->npages, sizeof(SDL_Texture*));
+    if(!font->textures){
+        SDL_SetError("Couldn't allocate memory for PCF_StaticFont textures\n");
+        return;
+    }
+    PCF_TRACE_BEGIN("PCF_StaticFontCreateTexture", font);
+    for(int i = 0; i < font->npages; i++){
+        if(!font->textures[i])
+            font->textures[i] = SDL_CreateTextureFromSurface(renderer, font->pages[i]);
+    }
+    PCF_TRACE_END("PCF_StaticFontCreateTexture", font);
+    font->texture = font->textures[0];
+    /*TODO: Check if it's appropriate to free the surface*/
+}
+#elif USE_SGPU_TEXTURE
+/**
+ * Creates a texture for each page of the atlas. textures[i] is made out
+ * of pages[i], texture is the first one.
+ *
+ * @param font The static font.
+ */
+void PCF_StaticFontCreateTexture(PCF_StaticFont *font)
+{
+    if(!font->textures)
+        font->textures = SDL_calloc(font->npages, sizeof(GPU_Image*));
+    if(!font->textures){
+        SDL_SetError("Couldn't allocate memory for PCF_StaticFont textures\n");
+        return;
+    }
+    PCF_TRACE_BEGIN("PCF_StaticFontCreateTexture", font);
+    for(int i = 0; i < font->npages; i++){
+        if(!font->textures[i])
+            font->textures[i] = GPU_CopyImageFromSurface(font->pages[i]);
+    }
+    PCF_TRACE_END("PCF_StaticFontCreateTexture", font);
+    font->texture = font->textures[0];
+    /*TODO: Check if it's appropriate to free the surface*/
+}
+#endif
+
+
+
+/*
+ * Uploads @p area of page @p page to its texture, creating the texture
+ * if the page doesn't have one (yet). Does nothing if textures haven't
+ * been created with PCF_StaticFontCreateTexture.
+ */
+static bool PCF_StaticFontUpdateTexture(PCF_StaticFont *self, int page, SDL_Rect *area)
+{
+    if(!self->textures)
+        return true;
+
+    if(!self->textures[page]){
 #if USE_SDL2_TEXTURE
-        SDL_DestroyTexture(self->texture);
+        self->textures[page] = SDL_CreateTextureFromSurface(self->renderer, self->pages[page]);
 #elif USE_SGPU_TEXTURE
-        GPU_FreeImage(self->texture);
+        self->textures[page] = GPU_CopyImageFromSurface(self->pages[page]);
 #endif
-        SDL_free(self);
-    }else{
-        self->refcnt--;
+        self->texture = self->textures[0];
+        return self->textures[page] != NULL;
+    }
+
+#if USE_SDL2_TEXTURE
+    Uint32 format, key;
+    SDL_Surface *tmp;
+    SDL_BlendMode mode;
+    bool keyed;
+    int rv;
+
+    if(SDL_QueryTexture(self->textures[page], &format, NULL, NULL, NULL) != 0)
+        return false;
+    if(format == self->pages[page]->format->format){
+        return SDL_UpdateTexture(self->textures[page], area,
+            (Uint8*)self->pages[page]->pixels
+                + area->y * self->pages[page]->pitch
+                + area->x * self->pages[page]->format->BytesPerPixel,
+            self->pages[page]->pitch
+        ) == 0;
     }
+    /* The renderer picked another format for the texture (always the case with
+     * AtlasIndex8): convert the area before uploading it*/
+    tmp = SDL_CreateRGBSurfaceWithFormat(0, area->w, area->h, SDL_BITSPERPIXEL(format), format);
+    if(!tmp)
+        return false;
+    /* Straight copy: no blending and no colorkey, the palette already has a
+     * transparent background, like SDL_CreateTextureFromSurface would do*/
+    keyed = SDL_GetColorKey(self->pages[page], &key) == 0;
+    if(keyed)
+        SDL_SetColorKey(self->pages[page], SDL_FALSE, 0);
+    SDL_GetSurfaceBlendMode(self->pages[page], &mode);
+    SDL_SetSurfaceBlendMode(self->pages[page], SDL_BLENDMODE_NONE);
+    SDL_BlitSurface(self->pages[page], area, tmp, NULL);
+    SDL_SetSurfaceBlendMode(self->pages[page], mode);
+    if(keyed)
+        SDL_SetColorKey(self->pages[page], SDL_TRUE, key);
+    rv = SDL_UpdateTexture(self->textures[page], &(SDL_Rect){area->x, area->y, area->w, area->h}, tmp->pixels, tmp->pitch);
+    SDL_FreeSurface(tmp);
+    return rv == 0;
+#elif USE_SGPU_TEXTURE
+    GPU_UpdateImage(self->textures[page],
+        &(GPU_Rect){area->x, area->y, area->w, area->h},
+        self->pages[page],
+        &(GPU_Rect){area->x, area->y, area->w, area->h}
+    );
+    return true;
+#endif
 }
 
 /**
- * Finds the index of a given char. Internal use only.
+ * Adds glyphs to an existing static font. Glyphs for chars of @p chars
+ * that @p sfont doesn't have yet are drawn in free atlas space and only
+ * the changed area of the textures, if any, is uploaded again.
  *
- * @param font The static font to search in.
- * @param c    The char to search for.
+ * When the atlas is full, the last page grows or a new page is added.
+ * Those get a brand new texture, use PCF_StaticFontOptions.spare_glyphs
+ * at creation time to avoid it.
  *
- * @return the index or negative if not found
+ * Glyphs are drawn in the font color (see PCF_FontCreateStaticFont) and
+ * appended after the existing ones: sfont->glyphs is no more sorted after
+ * this call. Static fonts made with a PCF_AtlasBuilder or from proportional
+ * fonts (packed without spare room) can't grow.
+ *
+ * @param sfont The static font to grow.
+ * @param font The font @p sfont has been created with.
+ * @param chars The chars that must be available, UTF-8 encoded.
+ * @return true on success, false on error. Details of the failure can be
+ * retreived with SDL_GetError().
  */
-static inline int PCF_StaticFontGetGlyphIndex(PCF_StaticFont *font, int c)
+bool PCF_StaticFontEnsureGlyphs(PCF_StaticFont *sfont, PCF_Font *font, const char *chars)
 {
-    char *pos = memchr(font->glyphs, c, font->nglyphs);
-    return pos - font->glyphs;
+    size_t len;
+    Uint32 c;
+    int nmissing;
+    void *tmp;
+    SDL_Rect *dirty;
+    bool rv;
+
+    /*No slot layout: made by a PCF_AtlasBuilder, from a proportional font or loaded from those*/
+    if(sfont->shared || !sfont->page_cols){
+        SDL_SetError("%s: static fonts made by a PCF_AtlasBuilder or from proportional fonts can't grow", __FUNCTION__);
+        return false;
+    }
+
+    len = strlen(chars);
+    nmissing = 0;
+    for(size_t i = 0; i < len; ){
+        i += utf8_decode(chars + i, len - i, &c);
+        if(PCF_StaticFontGetGlyphIndex(sfont, c) < 0)
+            nmissing++;
+    }
+    if(!nmissing)
+        return true;
+
+    /*Upper bound, chars may have duplicates*/
+    if(sfont->nglyphs + nmissing >= UINT16_MAX){
+        SDL_SetError("%s: too many glyphs, max is %d", __FUNCTION__, UINT16_MAX - 1);
+        return false;
+    }
+    tmp = SDL_realloc(sfont->glyphs, (sfont->nglyphs + nmissing) * sizeof(Uint32));
+    if(tmp) sfont->glyphs = tmp;
+    tmp = tmp ? SDL_realloc(sfont->glyph_heights, (sfont->nglyphs + nmissing) * sizeof(InkHeight)) : NULL;
+    if(tmp) sfont->glyph_heights = tmp;
+    tmp = tmp ? SDL_realloc(sfont->cells, (sfont->nglyphs + nmissing + 1) * sizeof(PCF_AtlasCell)) : NULL;
+    if(tmp) sfont->cells = tmp;
+    if(!tmp){
+        SDL_SetError("Couldn't allocate memory for PCF_StaticFont glyph data\n");
+        return false;
+    }
+    /*The implicit default glyph and the new ones take one slot each*/
+    if(!PCF_StaticFontReserveSlots(sfont, sfont->nglyphs + 1 + nmissing))
+        return false;
+
+    dirty = SDL_calloc(sfont->npages, sizeof(SDL_Rect));
+    if(!dirty){
+        SDL_SetError("Couldn't allocate memory for PCF_StaticFont update\n");
+        return false;
+    }
+
+    for(size_t i = 0; i < len; ){
+        int n;
+
+        i += utf8_decode(chars + i, len - i, &c);
+        if(PCF_StaticFontGetGlyphIndex(sfont, c) >= 0)
+            continue;
+
+        n = sfont->nglyphs;
+        if(!PCF_StaticFontIndexGlyph(sfont, c, n)){
+            SDL_free(dirty);
+            return false;
+        }
+        /*The default glyph stays where it is, always last in cells*/
+        sfont->cells[n + 1] = sfont->cells[n];
+        sfont->cells[n] = PCF_StaticFontSlotCell(sfont, n + 1);
+        sfont->glyphs[n] = c;
+        sfont->nglyphs++;
+        PCF_StaticFontRasterizeGlyph(sfont, font, n);
+
+        if(SDL_RectEmpty(&dirty[sfont->cells[n].page]))
+            dirty[sfont->cells[n].page] = sfont->cells[n].src;
+        else
+            SDL_UnionRect(&dirty[sfont->cells[n].page], &sfont->cells[n].src, &dirty[sfont->cells[n].page]);
+    }
+
+    rv = true;
+    PCF_TRACE_BEGIN("PCF_StaticFontUpdateTexture", sfont);
+    for(int i = 0; i < sfont->npages; i++){
+        if(SDL_RectEmpty(&dirty[i]) && !(sfont->textures && !sfont->textures[i]))
+            continue;
+        if(!PCF_StaticFontUpdateTexture(sfont, i, &dirty[i]))
+            rv = false;
+    }
+    PCF_TRACE_END("PCF_StaticFontUpdateTexture", sfont);
+    SDL_free(dirty);
+
+    return rv;
 }
 
-/**
- * Find the area in self->raster holding a glyph for c. The area is
- * suitable for a SDL_BlitSurface or a SDL_RenderCopy operation using
- * self->raster as a source
- *
- * @param font The static font to search in.
- * @param c    The char to search for.
- * @param glyph Location where to put the coordinates, when found.
- * @return 0 for whitespace (@glpyh untouched), non-zero if @param font
- * has something printable for @param c: 1 if the char as been found,
- * -1 otherwise. When returning -1, glpyh has been set to the default glyph.
+/*
+ * Index of @p color in @p palette, adding it if needed. Entry 0 is
+ * the transparent background and is never matched, 0 is returned
+ * when the palette is full.
  */
-int PCF_StaticFontGetCharRect(PCF_StaticFont *font, int c, SDL_Rect *glyph)
+static Uint8 palette_add_color(SDL_Color *palette, int *ncolors, SDL_Color *color)
 {
     int i;
-    int rv;
-
-    if(c == ' ')
-        return 0;
 
-    rv = 1;
-    i = PCF_StaticFontGetGlyphIndex(font, c);
-    if(i < 0){
-        rv = SDL_SetError("%s: %c: glpyh not found in font %p",__FUNCTION__, c, font);
-        /*make i point to the implicit default char*/
-        i = font->nglyphs;
+    for(i = 1; i < *ncolors && memcmp(&palette[i], color, sizeof(SDL_Color)) != 0; i++);
+    if(i == *ncolors){
+        if(*ncolors == 256)
+            return 0;
+        palette[(*ncolors)++] = *color;
     }
+    return i;
+}
 
-    /*The raster is a single glpyh height: All glyphs
-     * begin at 0,0 and end at raster->h-1 (height-wise)*/
-    glyph->y = 0;
-    /* First char(0) goes(x-wise) from 0 to width-1. Next char
-     * starts at width, ends at width+width-1, etc.*/
-    glyph->x = i * font->metrics.characterWidth;
-    glyph->h = font->raster->h;
-    glyph->w = font->metrics.characterWidth;
-
-    return rv;
+static void PCF_SharedAtlasUnref(PCF_SharedAtlas *self)
+{
+    if(--self->refcnt > 0)
+        return;
+    PCF_FreeAtlasPages(self->npages, self->pages, self->textures);
+    SDL_free(self);
 }
 
 /**
- * Computes space (pixels width*height) needed to draw a string using a given
- * font. Both @param w and @param h can be NULL depending on which metric you
- * are interested in. The function won't fail if both are NULL, it'll just be
- * useless.
+ * Creates a builder that packs the glyphs of several fonts in a single
+ * atlas: static fonts created through the builder share the same pages
+ * and textures, allowing renderers to draw text in different fonts
+ * without switching textures.
  *
- * @param str The string whose size you need to know.
- * @param tight If true, the rendering will use ink metrics (tight bounding box)
- * instead of full font metrics. This trims empty space above and below the text.
- * @param font The font you want to use to write that string
- * @param w Pointer to somewhere to place the resulting width. Can be NULL.
- * @param h Pointer to somewhere to place the resulting height. Can be NULL.
+ * Usage: add fonts with PCF_AtlasBuilderAddFont, call PCF_AtlasBuilderBuild
+ * and free the builder. The static fonts remain valid until freed with
+ * PCF_FreeStaticFont.
  *
+ * @param options Atlas page size and format, NULL to use the defaults.
+ * spare_glyphs is ignored: static fonts from a builder can't grow.
+ * @return a newly allocated PCF_AtlasBuilder or NULL on error. The error will be
+ * available with SDL_GetError()
  */
-void PCF_StaticFontGetSizeRequest(PCF_StaticFont *font, const char *str, bool tight, Uint32 *w, Uint32 *h)
+PCF_AtlasBuilder *PCF_CreateAtlasBuilder(PCF_StaticFontOptions *options)
 {
-    int len;
+    PCF_AtlasBuilder *rv;
 
-    len = strlen(str);
-    if(w)
-        *w = font->metrics.characterWidth * len;
-    if(h){
-        if(tight){
-            int ascent_max = 0;
-            int descent_max = 0;
-
-            BitmapFontRec *bitmapFont;
-            for(int i = 0; i < len; i++){
-                int glyph_index = PCF_StaticFontGetGlyphIndex(font, str[i]);
-                if(glyph_index < 0) continue;
-                ascent_max = MAX(ascent_max, font->glyph_heights[glyph_index].ascent);
-                descent_max = MAX(descent_max, font->glyph_heights[glyph_index].descent);
-            }
-            *h = ascent_max + descent_max;
-        }else{
-            *h = font->metrics.ascent + font->metrics.descent;
-        }
+    rv = SDL_calloc(1, sizeof(PCF_AtlasBuilder));
+    if(!rv){
+        SDL_SetError("Couldn't allocate memory for new PCF_AtlasBuilder\n");
+        return NULL;
     }
+    if(options)
+        rv->options = *options;
+    if(rv->options.max_page_width <= 0)
+        rv->options.max_page_width = PCF_STATIC_FONT_PAGE_SIZE;
+    if(rv->options.max_page_height <= 0)
+        rv->options.max_page_height = PCF_STATIC_FONT_PAGE_SIZE;
 
+    return rv;
+}
 
+/**
+ * Frees a builder. Static fonts it made are left untouched.
+ *
+ * @param self The PCF_AtlasBuilder to free.
+ */
+void PCF_FreeAtlasBuilder(PCF_AtlasBuilder *self)
+{
+    for(int i = 0; i < self->nfonts; i++){
+        PCF_FreeStaticFont(self->fonts[i]);
+        PCF_CloseFont(self->sources[i]);
+    }
+    SDL_free(self->fonts);
+    SDL_free(self->sources);
+    SDL_free(self);
 }
 
 /**
- * Same PCF_StaticFontGetSizeRequest as but fills an SDL_Rect. Rect x and y
- * get initialized to 0.
+ * Adds a font to the atlas. See PCF_FontCreateStaticFont for the meaning
+ * of the parameters.
  *
- * @param str The string whose size you need to know.
- * @param tight If true, the rendering will use ink metrics (tight bounding box)
- * instead of full font metrics. This trims empty space above and below the text.
- * @param font The font you want to use to write that string
- * @param rect Pointer to an existing SDL_Rect (cannot be NULL) to fill with
- * the size request.
+ * The returned static font has no glyphs drawn (and no pages) until
+ * PCF_AtlasBuilderBuild is called. @p font can be closed right away,
+ * the builder keeps a reference.
+ *
+ * @param self The builder.
+ * @param font See PCF_FontCreateStaticFont @param font
+ * @param color See PCF_FontCreateStaticFont @param color
+ * @param nsets See PCF_FontCreateStaticFont @param nsets
+ * @param ... See PCF_FontCreateStaticFont @param ...
+ * @return a newly allocated PCF_StaticFont, to be freed with
+ * PCF_FreeStaticFont, or NULL on error. The error will be available with
+ * SDL_GetError()
  */
-void PCF_StaticFontGetSizeRequestRect(PCF_StaticFont *font, const char *str, bool tight, SDL_Rect *rect)
+PCF_StaticFont *PCF_AtlasBuilderAddFont(PCF_AtlasBuilder *self, PCF_Font *font, SDL_Color *color, int nsets, ...)
 {
-    Uint32 w, h;
+    va_list ap;
+    char *tmp;
+    size_t tlen;
+    PCF_StaticFont *rv;
+    void *grown;
+
+    if(self->built){
+        SDL_SetError("%s: atlas already built", __FUNCTION__);
+        return NULL;
+    }
+
+    grown = SDL_realloc(self->fonts, (self->nfonts + 1) * sizeof(PCF_StaticFont*));
+    if(grown) self->fonts = grown;
+    grown = grown ? SDL_realloc(self->sources, (self->nfonts + 1) * sizeof(PCF_Font*)) : NULL;
+    if(grown) self->sources = grown;
+    if(!grown){
+        SDL_SetError("Couldn't allocate memory for PCF_AtlasBuilder fonts\n");
+        return NULL;
+    }
+
+    tlen = 0;
+    va_start(ap, nsets);
+    for(int i = 0; i < nsets; i++){
+        tmp = va_arg(ap, char*);
+        tlen += strlen(tmp);
+    }
+    va_end(ap);
 
-    PCF_StaticFontGetSizeRequest(font, str, tight, &w, &h);
+    va_start(ap, nsets);
+    rv = PCF_StaticFontNew(font, color, &self->options, nsets, tlen, ap);
+    va_end(ap);
+    if(!rv)
+        return NULL;
 
-    rect->x = 0;
-    rect->y = 0;
-    rect->w = w;
-    rect->h = h;
+    self->fonts[self->nfonts] = PCF_StaticFontRef(rv);
+    self->sources[self->nfonts] = PCF_FontRef(font);
+    self->nfonts++;
+
+    return rv;
 }
 
 /**
- * @see PCF_FontGetStringMaxInkAscent
+ * Packs the glyphs of all fonts added to @p self in shared atlas pages
+ * and draws them. Glyphs are packed by rows of decreasing height, a new
+ * page being used when one is full. Pages are as wide as needed to get
+ * a near-square atlas, within the page size limits.
  *
- * @param font The font you want to use to write that string
- * @param str The string to write.
+ * With AtlasIndex8, each color takes a palette entry: up to 255 different
+ * colors can be used.
  *
- * @returns the height
+ * @param self The builder.
+ * @return true on success, false on error. Details of the failure can be
+ * retreived with SDL_GetError().
  */
-Uint32 PCF_StaticFontGetStringMaxInkAscent(PCF_StaticFont *font, const char *str)
+bool PCF_AtlasBuilderBuild(PCF_AtlasBuilder *self)
 {
-    int len;
-    int rv;
+    PCF_SharedAtlas *atlas;
+    ShelfPacker packer = {0};
+    int *order;
+    int page_w, total_area;
+    int widest, area;
+    SDL_Color palette[256];
+    int ncolors;
+    bool rv;
 
-    len = strlen(str);
+    if(self->built || !self->nfonts){
+        SDL_SetError("%s: atlas already built or empty", __FUNCTION__);
+        return false;
+    }
 
-    rv = 0;
-    for(int i = 0; i < len; i++){
-        int glyph_index = PCF_StaticFontGetGlyphIndex(font, (unsigned char)str[i]);
-        if(glyph_index < 0) continue;
-        rv = MAX(rv, font->glyph_heights[glyph_index].ascent);
+    PCF_TRACE_BEGIN("PCF_AtlasBuilderBuild", self);
+    order = SDL_calloc(self->nfonts, sizeof(int));
+    packer.page_heights = SDL_calloc(UINT8_MAX + 1, sizeof(int));
+    atlas = SDL_calloc(1, sizeof(PCF_SharedAtlas));
+    rv = false;
+    if(!order || !packer.page_heights || !atlas){
+        SDL_SetError("Couldn't allocate memory for PCF_AtlasBuilder layout\n");
+        goto end;
+    }
+
+    /*Tallest fonts first, so that rows hold glyphs of similar heights*/
+    page_w = 0;
+    total_area = 0;
+    for(int i = 0; i < self->nfonts; i++){
+        PCF_StaticFont *font = self->fonts[i];
+        int j;
+
+        PCF_StaticFontCellsExtent(font, &widest, &area);
+        if(   widest > self->options.max_page_width
+           || PCF_StaticFontCellHeight(font) > self->options.max_page_height){
+            SDL_SetError("%s: %dx%d glyphs don't fit in %dx%d atlas pages",
+                __FUNCTION__,
+                widest, PCF_StaticFontCellHeight(font),
+                self->options.max_page_width, self->options.max_page_height
+            );
+            goto end;
+        }
+        page_w = SDL_max(page_w, widest);
+        total_area += area;
+
+        for(j = i; j > 0 && PCF_StaticFontCellHeight(self->fonts[order[j-1]]) < PCF_StaticFontCellHeight(font); j--)
+            order[j] = order[j-1];
+        order[j] = i;
+    }
+    page_w = SDL_max(page_w, SDL_min(self->options.max_page_width, (int)SDL_ceil(SDL_sqrt(total_area))));
+
+    packer.page_w = page_w;
+    packer.max_h = self->options.max_page_height;
+    for(int i = 0; i < self->nfonts; i++){
+        if(!PCF_StaticFontPackCells(self->fonts[order[i]], &packer))
+            goto end;
+    }
+
+    /*With AtlasIndex8, palette entry 0 is the transparent background*/
+    palette[0] = self->fonts[0]->text_color;
+    palette[0].a = SDL_ALPHA_TRANSPARENT;
+    ncolors = 1;
+    for(int i = 0; i < self->nfonts && self->options.format == AtlasIndex8; i++){
+        PCF_StaticFont *font = self->fonts[i];
+
+        font->palette_index = palette_add_color(palette, &ncolors, &font->text_color);
+        if(font->effect != EffectNone)
+            font->effect_palette_index = palette_add_color(palette, &ncolors, &font->effect_color);
+        if(!font->palette_index || (font->effect != EffectNone && !font->effect_palette_index)){
+            SDL_SetError("%s: more than 255 colors in an AtlasIndex8 atlas", __FUNCTION__);
+            goto end;
+        }
+    }
+
+    atlas->npages = packer.page + 1;
+    atlas->pages = SDL_calloc(atlas->npages, sizeof(SDL_Surface*));
+    atlas->textures = SDL_calloc(atlas->npages, sizeof(PCF_AtlasTexture*));
+    if(!atlas->pages || !atlas->textures){
+        SDL_SetError("Couldn't allocate memory for PCF_AtlasBuilder pages\n");
+        goto end;
+    }
+    for(int i = 0; i < atlas->npages; i++){
+        atlas->pages[i] = PCF_StaticFontCreatePage(page_w, packer.page_heights[i], self->options.format, palette, ncolors);
+        if(!atlas->pages[i])
+            goto end;
+    }
+
+    for(int i = 0; i < self->nfonts; i++){
+        PCF_StaticFont *font = self->fonts[i];
+
+        atlas->refcnt++;
+        font->shared = atlas;
+        font->npages = atlas->npages;
+        font->pages = atlas->pages;
+        font->textures = atlas->textures;
+        font->raster = atlas->pages[0];
+        for(int j = 0; j <= font->nglyphs; j++)
+            PCF_StaticFontRasterizeGlyph(font, self->sources[i], j);
     }
+    atlas = NULL; /*Now owned by the fonts*/
+    self->built = true;
+    rv = true;
+
+end:
+    if(atlas)
+        PCF_FreeAtlasPages(atlas->npages, atlas->pages, atlas->textures);
+    SDL_free(atlas);
+    SDL_free(packer.page_heights);
+    SDL_free(order);
+    PCF_TRACE_END("PCF_AtlasBuilderBuild", self);
     return rv;
 }
 
-/**
- * See PCF_FontGetStringTopInkOffset.
+/*
+ * Static font file layout, all values little-endian:
  *
- * @param font The font you want to use to write that string
- * @param str The string to write.
+ * header (34 bytes):
+ *   "SFPC", Uint16 version, Uint8 format, Uint8 npages,
+ *   Uint16 nglyphs, Uint16 page_cols, Uint16 page_rows,
+ *   Uint8 palette_index, Uint8 scale (0 in older files, meaning 1),
+ *   Sint16 metrics (already scaled) (leftSideBearing, rightSideBearing, characterWidth,
+ *   ascent, descent, attributes), Uint8 text_color RGBA,
+ *   Uint16 flags (reserved before version 3)
+ * version 2 and later (8 bytes):
+ *   Uint8 effect, Uint8 effect_palette_index, Sint8 shadow_dx,
+ *   Sint8 shadow_dy, Uint8 effect_color RGBA
+ * npages * {Uint16 w, Uint16 h}
+ * nglyphs * Uint32 codepoint
+ * nglyphs * {Sint16 ascent, Sint16 descent}
+ * (nglyphs + 1) * {Uint16 x, Uint16 y, Uint16 w, Uint16 h, Uint8 page, Uint8 reserved}
+ * PCF_STATIC_FONT_FILE_PROPORTIONAL only: (nglyphs + 1) * {Sint16 bearing, Sint16 width, Sint16 advance}
+ * AtlasIndex8 only: npages * {Uint16 ncolors, ncolors * Uint8 RGBA}
+ * npages * pixels: h rows of w * bytes per pixel, each page starting on
+ * a PCF_STATIC_FONT_FILE_ALIGN boundary.
  *
- * @returns the offset
+ * Pixels are stored the way they are in memory (SDL_PIXELFORMAT_RGBA32 or
+ * SDL_PIXELFORMAT_INDEX8), a mmapped file can be passed as is to
+ * SDL_UpdateTexture.
  */
-Uint32 PCF_StaticFontGetStringTopInkOffset(PCF_StaticFont *font, const char *str)
+#define PCF_STATIC_FONT_FILE_MAGIC "SFPC"
+#define PCF_STATIC_FONT_FILE_VERSION 3
+#define PCF_STATIC_FONT_FILE_PROPORTIONAL (1 << 0) /*flags: glyph widths follow cells*/
+
+static bool PCF_StaticFontWritePadding(SDL_RWops *dst, Sint64 *offset)
 {
-    return font->metrics.ascent - PCF_StaticFontGetStringMaxInkAscent(font, str);
-}
+    static const Uint8 zeros[PCF_STATIC_FONT_FILE_ALIGN] = {0};
+    size_t pad;
 
+    pad = (PCF_STATIC_FONT_FILE_ALIGN - *offset % PCF_STATIC_FONT_FILE_ALIGN) % PCF_STATIC_FONT_FILE_ALIGN;
+    if(pad && SDL_RWwrite(dst, zeros, pad, 1) != 1)
+        return false;
+    *offset += pad;
+    return true;
+}
 
 /**
- * @brief Generate a set of areas to blit from/to in order to write @p str using @p font
+ * Writes a static font to @p dst, atlas pixels included, see
+ * PCF_StaticFontLoadRW. Textures are not saved.
  *
- * This function will generate up to @p npatches char patches at location @p patches. Each
- * patch has two top-left corners of font widthxheight rectangles one being the source (blit from
- * @p font->raster or @p font->texture) and the other destination (where to blit the char to have
- * a continuous one-line string)
+ * A static font made by a PCF_AtlasBuilder is saved along with the whole
+ * shared atlas: the loaded copy will have its own pages.
  *
- * @param font a PCF_StaticFont
- * @param str the string to write
- * @param tight If true, the rendering will use ink metrics (tight bounding box) instead
- * of full font metrics. This trims empty space above and below the text.
- * @param len the length of the string to write, -1 to compute it.
- * @p location of top-left start position the cursor or NULL to start at 0,0. If not NULL,
- * this function will advance the location at the end of the string and size it to the maximum
- * area used by one glyph.
- * @p npatches size of @p patches. Must be the same size of str (spaces won't output a patch)
- * @p patches pointer to a large enough array of PCF_StaticFontPatches
- * @return number of patches actually written
+ * @param font The static font to save.
+ * @param dst Where to write.
+ * @param freedst Close @p dst before returning, even on error.
+ * @return true on success, false on error. Details of the failure can be
+ * retreived with SDL_GetError().
  */
-size_t PCF_StaticFontPreWriteString(PCF_StaticFont *font, int len, const char *str, bool tight,
-                                    SDL_Rect *location, size_t npatches, PCF_StaticFontPatch *patches)
+bool PCF_StaticFontSaveRW(PCF_StaticFont *font, SDL_RWops *dst, bool freedst)
 {
-    size_t rv;
-    SDL_Rect glyph;
-    SDL_Rect *cursor;
-    Uint32 offset;
+    Sint64 offset;
+    size_t n;
+    bool rv;
 
-    offset = tight ? PCF_StaticFontGetStringTopInkOffset(font, str) : 0;
+    rv = false;
+    n = 0;
+    n += SDL_RWwrite(dst, PCF_STATIC_FONT_FILE_MAGIC, 4, 1);
+    n += SDL_WriteLE16(dst, PCF_STATIC_FONT_FILE_VERSION);
+    n += SDL_WriteU8(dst, font->format);
+    n += SDL_WriteU8(dst, font->npages);
+    n += SDL_WriteLE16(dst, font->nglyphs);
+    n += SDL_WriteLE16(dst, font->page_cols);
+    n += SDL_WriteLE16(dst, font->page_rows);
+    n += SDL_WriteU8(dst, font->palette_index);
+    n += SDL_WriteU8(dst, font->scale);
+    n += SDL_WriteLE16(dst, font->metrics.leftSideBearing);
+    n += SDL_WriteLE16(dst, font->metrics.rightSideBearing);
+    n += SDL_WriteLE16(dst, font->metrics.characterWidth);
+    n += SDL_WriteLE16(dst, font->metrics.ascent);
+    n += SDL_WriteLE16(dst, font->metrics.descent);
+    n += SDL_WriteLE16(dst, font->metrics.attributes);
+    n += SDL_RWwrite(dst, &font->text_color, sizeof(SDL_Color), 1);
+    n += SDL_WriteLE16(dst, font->glyph_widths ? PCF_STATIC_FONT_FILE_PROPORTIONAL : 0);
+    n += SDL_WriteU8(dst, font->effect);
+    n += SDL_WriteU8(dst, font->effect_palette_index);
+    n += SDL_WriteU8(dst, font->shadow_dx);
+    n += SDL_WriteU8(dst, font->shadow_dy);
+    n += SDL_RWwrite(dst, &font->effect_color, sizeof(SDL_Color), 1);
+    if(n != 22)
+        goto end;
+    offset = 34 + 8;
 
-    cursor = location ? location : &(SDL_Rect){
-        .x = 0,
-        .y = 0
-    };
-    /* We don't use these values in the function but set them for the calling code
-     * to know what we have done
-     */
-    cursor->w = PCF_StaticFontCharWidth(font);
-    cursor->h = PCF_StaticFontCharHeight(font) - offset;
+    for(int i = 0; i < font->npages; i++){
+        if(!SDL_WriteLE16(dst, font->pages[i]->w) || !SDL_WriteLE16(dst, font->pages[i]->h))
+            goto end;
+    }
+    offset += font->npages * 4;
+    for(int i = 0; i < font->nglyphs; i++){
+        if(!SDL_WriteLE32(dst, font->glyphs[i]))
+            goto end;
+    }
+    offset += font->nglyphs * 4;
+    for(int i = 0; i < font->nglyphs; i++){
+        if(   !SDL_WriteLE16(dst, font->glyph_heights[i].ascent)
+           || !SDL_WriteLE16(dst, font->glyph_heights[i].descent))
+            goto end;
+    }
+    offset += font->nglyphs * 4;
+    for(int i = 0; i <= font->nglyphs; i++){
+        PCF_AtlasCell *cell = &font->cells[i];
+        n = 0;
+        n += SDL_WriteLE16(dst, cell->src.x);
+        n += SDL_WriteLE16(dst, cell->src.y);
+        n += SDL_WriteLE16(dst, cell->src.w);
+        n += SDL_WriteLE16(dst, cell->src.h);
+        n += SDL_WriteU8(dst, cell->page);
+        n += SDL_WriteU8(dst, 0);
+        if(n != 6)
+            goto end;
+    }
+    offset += (font->nglyphs + 1) * 10;
+    for(int i = 0; font->glyph_widths && i <= font->nglyphs; i++){
+        GlyphWidth *width = &font->glyph_widths[i];
+        if(   !SDL_WriteLE16(dst, width->bearing)
+           || !SDL_WriteLE16(dst, width->width)
+           || !SDL_WriteLE16(dst, width->advance))
+            goto end;
+    }
+    if(font->glyph_widths)
+        offset += (font->nglyphs + 1) * 6;
+    if(font->format == AtlasIndex8){
+        for(int i = 0; i < font->npages; i++){
+            SDL_Palette *palette = font->pages[i]->format->palette;
+            if(!SDL_WriteLE16(dst, palette->ncolors))
+                goto end;
+            if(SDL_RWwrite(dst, palette->colors, sizeof(SDL_Color), palette->ncolors) != palette->ncolors)
+                goto end;
+            offset += 2 + palette->ncolors * sizeof(SDL_Color);
+        }
+    }
 
-    if(len < 0)
-        len = strlen(str);
-    rv = 0;
-    for(int i = 0; i < len && rv < npatches; i++){
-        if( PCF_StaticFontGetCharRect(font, str[i], &glyph) != 0){ /*0 means white space*/
-            patches[rv].src = (SDL_Rect){
-                glyph.x,
-                glyph.y + offset,
-                glyph.w,
-                glyph.h - offset
-            };
-            patches[rv].dst = (SDL_Point){cursor->x, cursor->y};
-            rv++;
+    for(int i = 0; i < font->npages; i++){
+        SDL_Surface *page = font->pages[i];
+        size_t row;
+
+        if(!PCF_StaticFontWritePadding(dst, &offset))
+            goto end;
+        row = page->w * page->format->BytesPerPixel;
+        for(int y = 0; y < page->h; y++){
+            if(SDL_RWwrite(dst, (Uint8*)page->pixels + y * page->pitch, row, 1) != 1)
+                goto end;
         }
-        cursor->x += PCF_StaticFontCharWidth(font);
+        offset += row * page->h;
     }
+    rv = true;
 
+end:
+    if(!rv)
+        SDL_SetError("%s: couldn't write static font: %s", __FUNCTION__, SDL_GetError());
+    if(freedst)
+        SDL_RWclose(dst);
     return rv;
 }
 
 /**
- * @brief Generate a set of areas to blit from/to in order to write @p str
- * using @p font, with an optional offset.
+ * Writes a static font to a file, see PCF_StaticFontSaveRW.
  *
- * This function will generate up to @p npatches char patches at location
- * @p patches. Each patch has a source SDL_Rect area (blit from  @p font->raster
- * or @p font->texture) and an SDL_Point that represent the destination origin
- * where to blit the char to have a continuous one-line string) width and height
- * are already given in the src member.
+ * @param font The static font to save.
+ * @param filename The file to create or overwrite.
+ * @return true on success, false on error. Details of the failure can be
+ * retreived with SDL_GetError().
+ */
+bool PCF_StaticFontSave(PCF_StaticFont *font, const char *filename)
+{
+    SDL_RWops *dst;
+
+    dst = SDL_RWFromFile(filename, "wb");
+    if(!dst)
+        return false;
+    return PCF_StaticFontSaveRW(font, dst, true);
+}
+
+/**
+ * Reads a static font written by PCF_StaticFontSaveRW. No PCF font is
+ * needed and no glyph is drawn: atlas pixels are read as they are. Use
+ * PCF_StaticFontCreateTexture to get the textures.
  *
- * @param font a PCF_StaticFont
- * @param str the string to write
- * @param tight If true, the rendering will use ink metrics (tight bounding box)
- * instead of full font metrics. This trims empty space above and below the text.
- * @param len the length of the string to write, -1 to compute it.
- * @param location of top-left start position the cursor or NULL to start at 0,0.
- * @param xoffset Offset in pixels relative to location. For example a -10 offset
- * means that the string will be written as if it was moved to the left by 10 pixels.
- * With a 12px wide font, only the last 2 pixels of the first glyph would be visible.
- * @param npatches size of @p patches. Must of be the same size as str
- * (spaces will output a patch with src.x and src.y both set to -1)
- * @param patches pointer to a large enough array of PCF_StaticFontPartPatches
- * @return number of patches actually written
+ * @param src Where to read from. SDL_RWFromConstMem can be used on a
+ * memory-mapped file.
+ * @param freesrc Close @p src before returning, even on error.
+ * @return a newly allocated PCF_StaticFont, to be freed with
+ * PCF_FreeStaticFont, or NULL on error. The error will be available with
+ * SDL_GetError()
  */
-size_t PCF_StaticFontPreWriteStringOffset(PCF_StaticFont *font,
-                                          int len, const char *str,
-                                          bool tight, SDL_Rect *location,
-                                          int xoffset, int yoffset,
-                                          size_t npatches, PCF_StaticFontPatch *patches)
+PCF_StaticFont *PCF_StaticFontLoadRW(SDL_RWops *src, bool freesrc)
 {
-    size_t rv;
-    SDL_Rect glyph;
-    SDL_Rect cursor;
-    Uint32 offset;
+    PCF_StaticFont *rv;
+    char magic[4];
+    Sint64 offset;
+    Uint16 version;
+    Uint16 flags;
+    Uint16 *sizes;
 
-    offset = tight ? PCF_StaticFontGetStringTopInkOffset(font, str) : 0;
+    sizes = NULL;
+    rv = SDL_calloc(1, sizeof(PCF_StaticFont));
+    if(!rv){
+        SDL_SetError("Couldn't allocate memory for new PCF_StaticFont\n");
+        goto end;
+    }
 
-    cursor = (SDL_Rect){
-        .x = (location ? location->x : 0) + xoffset,
-        .y = (location ? location->y : 0) + yoffset,
-        .w = PCF_StaticFontCharWidth(font),
-        .h = PCF_StaticFontCharHeight(font)
-    };
-    cursor.h -= offset;
+    if(SDL_RWread(src, magic, 4, 1) != 1 || memcmp(magic, PCF_STATIC_FONT_FILE_MAGIC, 4) != 0){
+        SDL_SetError("%s: not a static font file", __FUNCTION__);
+        goto bail;
+    }
+    version = SDL_ReadLE16(src);
+    if(version < 1 || version > PCF_STATIC_FONT_FILE_VERSION){
+        SDL_SetError("%s: unsupported static font file version %d", __FUNCTION__, version);
+        goto bail;
+    }
+    rv->format = SDL_ReadU8(src);
+    rv->npages = SDL_ReadU8(src);
+    rv->nglyphs = SDL_ReadLE16(src);
+    rv->page_cols = SDL_ReadLE16(src);
+    rv->page_rows = SDL_ReadLE16(src);
+    rv->palette_index = SDL_ReadU8(src);
+    rv->scale = SDL_ReadU8(src);
+    if(!rv->scale)
+        rv->scale = 1;
+    rv->metrics.leftSideBearing = SDL_ReadLE16(src);
+    rv->metrics.rightSideBearing = SDL_ReadLE16(src);
+    rv->metrics.characterWidth = SDL_ReadLE16(src);
+    rv->metrics.ascent = SDL_ReadLE16(src);
+    rv->metrics.descent = SDL_ReadLE16(src);
+    rv->metrics.attributes = SDL_ReadLE16(src);
+    if(SDL_RWread(src, &rv->text_color, sizeof(SDL_Color), 1) != 1)
+        goto truncated;
+    flags = SDL_ReadLE16(src);
+    if(version < 3)
+        flags = 0;
+    offset = 34;
+    if(version >= 2){
+        PCF_StaticFontOptions effect = {0};
+        Uint8 effect_palette_index;
+
+        effect.effect = SDL_ReadU8(src);
+        effect_palette_index = SDL_ReadU8(src);
+        effect.shadow_offset.x = (Sint8)SDL_ReadU8(src);
+        effect.shadow_offset.y = (Sint8)SDL_ReadU8(src);
+        if(SDL_RWread(src, &effect.effect_color, sizeof(SDL_Color), 1) != 1)
+            goto truncated;
+        if(!PCF_StaticFontSetEffect(rv, &effect))
+            goto bail;
+        rv->effect_palette_index = effect_palette_index;
+        offset += 8;
+    }
+    if(   (rv->format != AtlasRGBA32 && rv->format != AtlasIndex8)
+       || !rv->npages || rv->nglyphs == UINT16_MAX
+       || rv->scale > PCF_STATIC_FONT_MAX_SCALE
+       || (rv->page_cols && (   !rv->page_rows
+                             || PCF_StaticFontCellWidth(rv) <= 0
+                             || PCF_StaticFontCellHeight(rv) <= 0))){
+        SDL_SetError("%s: corrupted static font file", __FUNCTION__);
+        goto bail;
+    }
 
-    if(len < 0)
-        len = strlen(str);
-    rv = 0;
+    sizes = SDL_calloc(rv->npages * 2, sizeof(Uint16));
+    rv->pages = SDL_calloc(rv->npages, sizeof(SDL_Surface*));
+    rv->glyphs = SDL_calloc(rv->nglyphs + 1, sizeof(Uint32));
+    rv->glyph_heights = SDL_calloc(rv->nglyphs + 1, sizeof(InkHeight));
+    rv->cells = SDL_calloc(rv->nglyphs + 1, sizeof(PCF_AtlasCell));
+    if(flags & PCF_STATIC_FONT_FILE_PROPORTIONAL)
+        rv->glyph_widths = SDL_calloc(rv->nglyphs + 1, sizeof(GlyphWidth));
+    if(   !sizes || !rv->pages || !rv->glyphs || !rv->glyph_heights || !rv->cells
+       || ((flags & PCF_STATIC_FONT_FILE_PROPORTIONAL) && !rv->glyph_widths)){
+        SDL_SetError("Couldn't allocate memory for PCF_StaticFont glyph data\n");
+        goto bail;
+    }
 
-    int skip = xoffset < 0 ? abs(xoffset)/PCF_StaticFontCharWidth(font) : 0;
-    cursor.x += skip * PCF_StaticFontCharWidth(font);
-    for(int i = skip; i < len && rv < npatches; i++){
-        /*TODO SDLExt_RectAbove/Below/Before/After*/
-        if(   cursor.x > SDLExt_RectLastX(location)
-           || cursor.y > SDLExt_RectLastY(location))
-            break;
+    if(SDL_RWread(src, sizes, sizeof(Uint16), rv->npages * 2) != rv->npages * 2)
+        goto truncated;
+    offset += rv->npages * 4;
+    for(int i = 0; i < rv->nglyphs; i++)
+        rv->glyphs[i] = SDL_ReadLE32(src);
+    offset += rv->nglyphs * 4;
+    for(int i = 0; i < rv->nglyphs; i++){
+        rv->glyph_heights[i].ascent = SDL_ReadLE16(src);
+        rv->glyph_heights[i].descent = SDL_ReadLE16(src);
+    }
+    offset += rv->nglyphs * 4;
+    for(int i = 0; i <= rv->nglyphs; i++){
+        PCF_AtlasCell *cell = &rv->cells[i];
+        cell->src.x = SDL_ReadLE16(src);
+        cell->src.y = SDL_ReadLE16(src);
+        cell->src.w = SDL_ReadLE16(src);
+        cell->src.h = SDL_ReadLE16(src);
+        cell->page = SDL_ReadU8(src);
+        SDL_ReadU8(src);
+    }
+    offset += (rv->nglyphs + 1) * 10;
+    for(int i = 0; rv->glyph_widths && i <= rv->nglyphs; i++){
+        rv->glyph_widths[i].bearing = SDL_ReadLE16(src);
+        rv->glyph_widths[i].width = SDL_ReadLE16(src);
+        rv->glyph_widths[i].advance = SDL_ReadLE16(src);
+    }
+    if(rv->glyph_widths)
+        offset += (rv->nglyphs + 1) * 6;
+
+    /*Pages of fonts that can grow must match their slot layout, see PCF_StaticFontReserveSlots*/
+    for(int i = 0; rv->page_cols && i < rv->npages; i++){
+        int w = SDL_SwapLE16(sizes[i*2]);
+        int h = SDL_SwapLE16(sizes[i*2+1]);
+
+        if(   w != (Sint64)rv->page_cols * PCF_StaticFontCellWidth(rv)
+           || h % PCF_StaticFontCellHeight(rv)
+           || h > (Sint64)rv->page_rows * PCF_StaticFontCellHeight(rv)){
+            SDL_SetError("%s: corrupted static font file", __FUNCTION__);
+            goto bail;
+        }
+    }
 
-        /*If we are here, there is an intersection*/
-        if(PCF_StaticFontGetCharRect(font, str[i], &glyph) != 0){ /*0 means white space*/
-            patches[rv].src = (SDL_Rect){
-                glyph.x,
-                glyph.y + offset,
-                glyph.w,
-                glyph.h - offset
-            };
-        }else{
-            /* We do this to have a patch for spaces that can be used to
-             * show the cursor in SoFIS (see text_box_render() in text-box.c).
-             * in that case we need the dst part to know where on the screen
-             * the space should vs just skipping the patch altogether like in
-             * the non-offset version.
-             * TODO: Document and maybe make that configurable in both functions
-             * TODO: Consider having an empty glyph (space) at the beginining of
-             * the string that would simplify the code. At the expense of a couple
-             * of bytes (code is likeyly larger anyways).
-             * */
-            patches[rv].src = (SDL_Rect){
-                -1,
-                -1,
-                PCF_StaticFontCharWidth(font),
-                PCF_StaticFontCharHeight(font) - offset
-            };
+    for(int i = 0; i < rv->npages; i++){
+        /*AtlasIndex8 palettes are read below*/
+        rv->pages[i] = PCF_StaticFontCreatePage(SDL_SwapLE16(sizes[i*2]), SDL_SwapLE16(sizes[i*2+1]),
+                                                rv->format, NULL, 0);
+        if(!rv->pages[i])
+            goto bail;
+    }
+    if(rv->format == AtlasIndex8){
+        for(int i = 0; i < rv->npages; i++){
+            SDL_Color colors[256];
+            Uint16 ncolors;
+
+            ncolors = SDL_ReadLE16(src);
+            if(ncolors > 256 || SDL_RWread(src, colors, sizeof(SDL_Color), ncolors) != ncolors)
+                goto truncated;
+            SDL_SetPaletteColors(rv->pages[i]->format->palette, colors, 0, ncolors);
+            offset += 2 + ncolors * sizeof(SDL_Color);
         }
-        SDL_Rect intersect;
-        SDL_IntersectRect(&cursor, location, &intersect);
-
-        patches[rv].dst = (SDL_Point){intersect.x, intersect.y};
-        if(intersect.w < patches[rv].src.w){
-            if(cursor.x < location->x){
-                int delta = patches[rv].src.w - intersect.w;
-                /*A negative start point (x,y) means a space. keep it*/
-                if(patches[rv].src.x >= 0)
-                    patches[rv].src.x += delta;
-                patches[rv].src.w -= delta;
-            }else{
-                patches[rv].src.w = intersect.w;
+    }
+
+    for(int i = 0; i < rv->npages; i++){
+        SDL_Surface *page = rv->pages[i];
+        Uint8 skip[PCF_STATIC_FONT_FILE_ALIGN];
+        size_t pad, row;
+
+        pad = (PCF_STATIC_FONT_FILE_ALIGN - offset % PCF_STATIC_FONT_FILE_ALIGN) % PCF_STATIC_FONT_FILE_ALIGN;
+        if(pad && SDL_RWread(src, skip, pad, 1) != 1)
+            goto truncated;
+        offset += pad;
+
+        row = page->w * page->format->BytesPerPixel;
+        if(row == page->pitch){
+            if(SDL_RWread(src, page->pixels, row * page->h, 1) != 1)
+                goto truncated;
+        }else{
+            for(int y = 0; y < page->h; y++){
+                if(SDL_RWread(src, (Uint8*)page->pixels + y * page->pitch, row, 1) != 1)
+                    goto truncated;
             }
         }
-        /* TODO: Compute only once, line height won't change
-         * as we go xward*/
-        if(intersect.h < patches[rv].src.h){
-            if(cursor.y < location->y){
-                int delta = patches[rv].src.h - intersect.h;
-                /*A negative start point (x,y) means a space. keep it*/
-                if(patches[rv].src.y >= 0)
-                    patches[rv].src.y += delta;
-                patches[rv].src.h -= delta;
-            }else{
-                patches[rv].src.h = intersect.h;
-            }
+        offset += row * page->h;
+    }
+    rv->raster = rv->pages[0];
+
+    for(int i = 0; i <= rv->nglyphs; i++){
+        if(   rv->cells[i].page >= rv->npages
+           || rv->cells[i].src.x + rv->cells[i].src.w > rv->pages[rv->cells[i].page]->w
+           || rv->cells[i].src.y + rv->cells[i].src.h > rv->pages[rv->cells[i].page]->h){
+            SDL_SetError("%s: corrupted static font file", __FUNCTION__);
+            goto bail;
         }
-
-        cursor.x += PCF_StaticFontCharWidth(font);
-        rv++;
+        if(i < rv->nglyphs && !PCF_StaticFontIndexGlyph(rv, rv->glyphs[i], i))
+            goto bail;
     }
+    goto end;
 
+truncated:
+    SDL_SetError("%s: truncated static font file", __FUNCTION__);
+bail:
+    PCF_FreeStaticFont(rv);
+    rv = NULL;
+end:
+    SDL_free(sizes);
+    if(freesrc)
+        SDL_RWclose(src);
     return rv;
 }
 
-
 /**
- * Check whether @param font can be used to write all chars given in
- * @param sequence in color @param color.
+ * Reads a static font from a file written by PCF_StaticFontSave, see
+ * PCF_StaticFontLoadRW.
  *
- * @param color The color you want to write in. If NULL the function
- * will assume that the desired color is the same as the font native
- * color, i.e NULL is equivalent to &font->color.
- * @param sequence All the chars you may want to use
- * @return true if all chars of @param sequence can be written in
- * @param color, false otherwise.
+ * @param filename The file to read.
+ * @return a newly allocated PCF_StaticFont, to be freed with
+ * PCF_FreeStaticFont, or NULL on error. The error will be available with
+ * SDL_GetError()
  */
-bool PCF_StaticFontCanWrite(PCF_StaticFont *font, SDL_Color *color, const char *sequence)
+PCF_StaticFont *PCF_StaticFontLoad(const char *filename)
 {
-    int len;
+    SDL_RWops *src;
 
-    if(color && memcmp(&font->text_color, color, sizeof(SDL_Color)) != 0){
-        return false;
-    }
+    src = SDL_RWFromFile(filename, "rb");
+    if(!src)
+        return NULL;
+    return PCF_StaticFontLoadRW(src, true);
+}
 
-    len = strlen(sequence);
-    if(len == font->nglyphs)
-        return strcmp(sequence, font->glyphs) == 0;
+/*
+ * Remove duplicates codepoints from base. base must be sorted
+ * so that duplicates follow each other (i.e. use qsort() beforehand).
+ *
+ * @param base The codepoints to filter
+ * @param len The number of codepoints in base
+ * @return the number of codepoints left
+ */
+static size_t filter_dedup(Uint32 *base, size_t len)
+{
+    size_t rv;
 
-    for(int i = 0; i < len; i++){
-        if(!strchr(font->glyphs, sequence[i]))
-            return false;
+    if(!len)
+        return 0;
+    rv = 1;
+    for(size_t i = 1; i < len; i++){
+        if(base[i] != base[rv-1])
+            base[rv++] = base[i];
     }
-
-    return true;
+    return rv;
 }
 
-#if USE_SDL2_TEXTURE
-void PCF_StaticFontCreateTexture(PCF_StaticFont *font, SDL_Renderer *renderer)
-{
-    font->texture = SDL_CreateTextureFromSurface(renderer, font->raster);
-    /*TODO: Check if it's appropriate to free the surface*/
-}
-#elif USE_SGPU_TEXTURE
-void PCF_StaticFontCreateTexture(PCF_StaticFont *font)
-{
-    font->texture = GPU_CopyImageFromSurface(font->raster);
-    /*TODO: Check if it's appropriate to free the surface*/
-}
-#endif
 
+/*
+ * qsort() comparator for codepoints.
+ */
+static int compare_codepoints(const void *a, const void *b)
+{
+    Uint32 ca = *(const Uint32*)a;
+    Uint32 cb = *(const Uint32*)b;
 
+    return (ca > cb) - (ca < cb);
+}
 
 /*
- * Remove duplicates characters from base. base must be sorted
- * so that duplicates follow each other (i.e. use qsort() beforehand).
+ * Decodes the UTF-8 sequence at the start of @p str. Decoding is lenient:
+ * a byte that doesn't start a valid sequence is taken as a Latin-1 char,
+ * so that plain 8-bit strings keep working.
  *
- * @param base The string to filter
- * @param len THe string len, -1 to have the function compute it.
+ * @param str The string to decode
+ * @param len Bytes available in @p str, must be at least 1
+ * @param cp Where to store the decoded codepoint
+ * @return the number of bytes consumed
  */
-static void filter_dedup(char *base, size_t len)
+static int utf8_decode(const char *str, size_t len, Uint32 *cp)
 {
-    len = len > -1 ? len : strlen(base);
+    const unsigned char *s = (const unsigned char *)str;
+    int n;
+    Uint32 rv;
 
-    for(int i = 1; i < len; i++){
-        if(base[i] == base[i-1]){
-            int next; /*Next different char idx*/
-            for(next = i; next < len && base[next] == base[i]; next++);
-            /* Index doesn't go OOB, last iteration will
-             * access (and move back) the final '\0' */
-            for(int j = next; j < len+1; j++){
-                base[i+(j-next)] = base[j];
-            }
-        }
+    if(s[0] < 0x80){
+        *cp = s[0];
+        return 1;
+    }
+
+    if(s[0] >= 0xc2 && s[0] <= 0xdf){
+        n = 1;
+        rv = s[0] & 0x1f;
+    }else if(s[0] >= 0xe0 && s[0] <= 0xef){
+        n = 2;
+        rv = s[0] & 0x0f;
+    }else if(s[0] >= 0xf0 && s[0] <= 0xf4){
+        n = 3;
+        rv = s[0] & 0x07;
+    }else{
+        goto latin1;
     }
-}
 
+    if(n >= len)
+        goto latin1;
+    for(int i = 1; i <= n; i++){
+        if((s[i] & 0xc0) != 0x80)
+            goto latin1;
+        rv = (rv << 6) | (s[i] & 0x3f);
+    }
+    /*Reject overlong forms, surrogates and out of range values*/
+    if(   (n == 2 && rv < 0x800)
+       || (n == 3 && rv < 0x10000)
+       || (rv >= 0xd800 && rv <= 0xdfff)
+       || rv > 0x10ffff)
+        goto latin1;
+
+    *cp = rv;
+    return n + 1;
+latin1:
+    *cp = s[0];
+    return 1;
+}
 
 /*
- * Convert a number(int/float/etc) into a string buffer
- * for printing
+ * Formats @p value at the end of @p buffer (PCF_NUMBER_BUFFER_SIZE bytes)
+ * without printf nor allocation: digits are produced from a 64-bit
+ * integer, floating-point values being scaled by 10^precision first
+ * (fixed-point). See PCF_FontWriteNumber for @p type and @p precision.
  *
+ * @return the start of the NUL-terminated number within @p buffer, NULL
+ * on error. Details of the failure can be retreived with SDL_GetError().
  */
-static bool number_to_ascii(void *value, PCF_NumberType type, int8_t precision, char *buffer, size_t buffer_len)
+static char *number_format(void *value, PCF_NumberType type, int8_t precision, char *buffer)
 {
-    switch(type){
+    static const double pow10[PCF_NUMBER_MAX_DECIMALS + 1] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+        1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+    };
+    Uint64 mag;
+    bool negative;
+    int decimals, min_digits;
+    double d;
+    char *p;
+
+    negative = false;
+    decimals = 0;
+    min_digits = precision > 0 ? precision : 1;
+    switch(type & ~PCF_NUMBER_FLAGS){
         case TypeInt:
-            if(precision)
-                snprintf(buffer, buffer_len, "%.*d", precision, *(int *)value);
-            else
-                snprintf(buffer, buffer_len, "%d", *(int *)value);
+            negative = *(int *)value < 0;
+            mag = negative ? -(Sint64)*(int *)value : *(int *)value;
             break;
         case TypeIntUnsigned:
-            if(precision)
-                snprintf(buffer, buffer_len, "%.*d", precision, *(unsigned int *)value);
-            else
-                snprintf(buffer, buffer_len, "%d", *(unsigned int *)value);
+            mag = *(unsigned int *)value;
             break;
-        case TypeFloat:
-            snprintf(buffer, buffer_len, "%.*f", precision >= 0 ? precision : 6, *(float *)value);
+        case TypeInt64:
+            negative = *(int64_t *)value < 0;
+            mag = negative ? (Uint64)0 - (Uint64)*(int64_t *)value : (Uint64)*(int64_t *)value;
             break;
+        case TypeIntUnsigned64:
+            mag = *(uint64_t *)value;
+            break;
+        case TypeFloat:
         case TypeDouble:
-            snprintf(buffer, buffer_len, "%.*f", precision >= 0 ? precision : 6, *(double *)value);
+            d = ((type & ~PCF_NUMBER_FLAGS) == TypeFloat) ? *(float *)value : *(double *)value;
+            decimals = precision >= 0 ? precision : 6;
+            min_digits = 1;
+            if(decimals > PCF_NUMBER_MAX_DECIMALS){
+                SDL_SetError("%s: precision %d is over %d digits",
+                    __FUNCTION__,
+                    precision,
+                    PCF_NUMBER_MAX_DECIMALS
+                );
+                return NULL;
+            }
+            if(isnan(d))
+                return strcpy(buffer, "nan");
+            if(isinf(d))
+                return strcpy(buffer, d < 0 ? "-inf" : "inf");
+            negative = d < 0;
+            /* Scale floats in single precision: 0.29f * 100 is then 29
+             * rather than 28.99999, digits past float precision being
+             * noise anyway*/
+            if((type & ~PCF_NUMBER_FLAGS) == TypeFloat)
+                d = fabsf(*(float *)value) * (float)pow10[decimals];
+            else
+                d = fabs(d) * pow10[decimals];
+            if(d >= 18446744073709551616.0){ /*2^64*/
+                SDL_SetError("%s: value too large for %d decimals", __FUNCTION__, decimals);
+                return NULL;
+            }
+            mag = (Uint64)d;
+            /* Round half to even like snprintf: 2.5 is "2", 3.5 is "4".
+             * Doubles that large have no fractional part, mag can't wrap*/
+            if(!(type & NumberTruncate) && (d - mag > 0.5 || (d - mag == 0.5 && (mag & 1))))
+                mag++;
             break;
         default:
             SDL_SetError("%s: Unknown value type: %d",
                 __FUNCTION__,
                 type
             );
-            return false;
+            return NULL;
     }
-    return true;
+    negative = negative && mag; /*No -0*/
+
+    p = buffer + PCF_NUMBER_BUFFER_SIZE - 1;
+    *p = '\0';
+    for(int i = 0; i < decimals; i++){
+        *--p = '0' + mag % 10;
+        mag /= 10;
+    }
+    if(decimals)
+        *--p = '.';
+    for(int i = 0; mag || i < min_digits; i++){
+        if(i && !(i % 3) && (type & NumberThousands))
+            *--p = ',';
+        *--p = '0' + mag % 10;
+        mag /= 10;
+    }
+    if(negative)
+        *--p = '-';
+    return p;
 }
@@ -0,0 +1,365 @@
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "SDL_error.h"
+#include "SDL_pixels.h"
+#include "SDL_pcf.h"
+#include "pcfstats.h"
+#include "pcftrace.h"
+#include "SDL_stdinc.h"
+#include "SDL_surface.h"
+
+#if USE_SDL2_TEXTURE
+
+#define PCF_TEXT_CACHE_MIN_BUCKETS 64
+
+struct _PCF_TextCacheEntry{
+    Uint32 hash;
+    PCF_Font *font;
+    SDL_Color color;
+    bool tight;
+    size_t len;
+    char *str;
+
+    SDL_Texture *texture;
+    int w, h;
+    size_t bytes;
+
+    PCF_TextCacheEntry *next; /*Next entry in the same bucket*/
+    PCF_TextCacheEntry *prev_lru;
+    PCF_TextCacheEntry *next_lru;
+};
+
+static void PCF_TextCacheEvict(PCF_TextCache *self, PCF_TextCacheEntry *entry);
+
+/*
+ * FNV-1a over everything that makes an entry unique.
+ */
+static Uint32 text_cache_hash(PCF_Font *font, const char *str, size_t len, SDL_Color *color, bool tight)
+{
+    Uint32 rv = 2166136261u;
+    uintptr_t fp = (uintptr_t)font;
+
+    for(size_t i = 0; i < sizeof(fp); i++){
+        rv ^= (fp >> (i * 8)) & 0xff;
+        rv *= 16777619u;
+    }
+    rv ^= color->r; rv *= 16777619u;
+    rv ^= color->g; rv *= 16777619u;
+    rv ^= color->b; rv *= 16777619u;
+    rv ^= color->a; rv *= 16777619u;
+    rv ^= tight;    rv *= 16777619u;
+    for(size_t i = 0; i < len; i++){
+        rv ^= (unsigned char)str[i];
+        rv *= 16777619u;
+    }
+    return rv;
+}
+
+/**
+ * Creates a cache of ready-made textures for strings drawn often: a cache
+ * hit costs a hash lookup and a single SDL_RenderCopy, regardless of the
+ * string length.
+ *
+ * Textures are kept until the cache grows past @p max_bytes, at which point
+ * the least recently used entries are dropped. The cache must be freed with
+ * PCF_FreeTextCache() before @p renderer gets destroyed.
+ *
+ * @param renderer The renderer the textures will be created for and
+ * drawn to.
+ * @param max_bytes Memory budget for all the textures, estimated at 4 bytes
+ * per pixel.
+ * @return a newly allocated PCF_TextCache or NULL on error. The error will be
+ * available with SDL_GetError()
+ */
+PCF_TextCache *PCF_CreateTextCache(SDL_Renderer *renderer, size_t max_bytes)
+{
+    PCF_TextCache *rv;
+
+    rv = SDL_calloc(1, sizeof(PCF_TextCache));
+    if(!rv){
+        SDL_SetError("Couldn't allocate memory for new PCF_TextCache\n");
+        return NULL;
+    }
+    rv->nbuckets = PCF_TEXT_CACHE_MIN_BUCKETS;
+    rv->buckets = SDL_calloc(rv->nbuckets, sizeof(PCF_TextCacheEntry*));
+    if(!rv->buckets){
+        SDL_SetError("Couldn't allocate memory for PCF_TextCache buckets\n");
+        SDL_free(rv);
+        return NULL;
+    }
+    rv->renderer = renderer;
+    rv->max_bytes = max_bytes;
+
+    return rv;
+}
+
+/**
+ * Frees a text cache and all the textures it holds.
+ *
+ * @param self The PCF_TextCache to free.
+ */
+void PCF_FreeTextCache(PCF_TextCache *self)
+{
+    PCF_TextCacheClear(self);
+    SDL_free(self->buckets);
+    SDL_free(self);
+}
+
+/**
+ * Drops all cached textures, releasing the fonts they were drawn with.
+ * Hit and miss counters are left untouched.
+ *
+ * @param self The PCF_TextCache to empty.
+ */
+void PCF_TextCacheClear(PCF_TextCache *self)
+{
+    while(self->lru)
+        PCF_TextCacheEvict(self, self->lru);
+}
+
+static void PCF_TextCacheUnlinkLRU(PCF_TextCache *self, PCF_TextCacheEntry *entry)
+{
+    if(entry->prev_lru)
+        entry->prev_lru->next_lru = entry->next_lru;
+    else
+        self->mru = entry->next_lru;
+
+    if(entry->next_lru)
+        entry->next_lru->prev_lru = entry->prev_lru;
+    else
+        self->lru = entry->prev_lru;
+
+    entry->prev_lru = entry->next_lru = NULL;
+}
+
+static void PCF_TextCachePushMRU(PCF_TextCache *self, PCF_TextCacheEntry *entry)
+{
+    entry->prev_lru = NULL;
+    entry->next_lru = self->mru;
+    if(self->mru)
+        self->mru->prev_lru = entry;
+    self->mru = entry;
+    if(!self->lru)
+        self->lru = entry;
+}
+
+static void PCF_TextCacheEvict(PCF_TextCache *self, PCF_TextCacheEntry *entry)
+{
+    PCF_TextCacheEntry **iter;
+
+    for(iter = &self->buckets[entry->hash & (self->nbuckets - 1)]; *iter; iter = &(*iter)->next){
+        if(*iter == entry){
+            *iter = entry->next;
+            break;
+        }
+    }
+    PCF_TextCacheUnlinkLRU(self, entry);
+
+    self->bytes -= entry->bytes;
+    self->nentries--;
+    SDL_DestroyTexture(entry->texture);
+    PCF_CloseFont(entry->font);
+    SDL_free(entry->str);
+    SDL_free(entry);
+}
+
+/*
+ * Doubles the bucket count. Failing to do so is not an error, the
+ * cache will just have longer chains.
+ */
+static void PCF_TextCacheGrow(PCF_TextCache *self)
+{
+    PCF_TextCacheEntry **buckets;
+    size_t nbuckets;
+
+    nbuckets = self->nbuckets * 2;
+    buckets = SDL_calloc(nbuckets, sizeof(PCF_TextCacheEntry*));
+    if(!buckets)
+        return;
+
+    for(size_t i = 0; i < self->nbuckets; i++){
+        PCF_TextCacheEntry *entry, *next;
+        for(entry = self->buckets[i]; entry; entry = next){
+            next = entry->next;
+            entry->next = buckets[entry->hash & (nbuckets - 1)];
+            buckets[entry->hash & (nbuckets - 1)] = entry;
+        }
+    }
+    SDL_free(self->buckets);
+    self->buckets = buckets;
+    self->nbuckets = nbuckets;
+}
+
+static PCF_TextCacheEntry *PCF_TextCacheLookup(PCF_TextCache *self, Uint32 hash, PCF_Font *font,
+                                               const char *str, size_t len, SDL_Color *color, bool tight)
+{
+    PCF_TextCacheEntry *entry;
+
+    for(entry = self->buckets[hash & (self->nbuckets - 1)]; entry; entry = entry->next){
+        if(   entry->hash == hash
+           && entry->font == font
+           && entry->len == len
+           && entry->tight == tight
+           && memcmp(&entry->color, color, sizeof(SDL_Color)) == 0
+           && memcmp(entry->str, str, len) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+/*
+ * Draws @p str in a new texture. The texture holds exactly what
+ * PCF_FontRender would have drawn with the same parameters. The entry
+ * holds a reference on @p font.
+ */
+static PCF_TextCacheEntry *PCF_TextCacheCreateEntry(PCF_TextCache *self, Uint32 hash, PCF_Font *font,
+                                                    const char *str, size_t len, SDL_Color *color, bool tight)
+{
+    PCF_TextCacheEntry *rv;
+    SDL_Surface *surface;
+    Uint32 w, h;
+
+    rv = SDL_calloc(1, sizeof(PCF_TextCacheEntry));
+    if(!rv){
+        SDL_SetError("Couldn't allocate memory for new PCF_TextCacheEntry\n");
+        return NULL;
+    }
+    rv->str = SDL_malloc(len + 1);
+    if(!rv->str){
+        SDL_SetError("Couldn't allocate memory for PCF_TextCacheEntry string\n");
+        SDL_free(rv);
+        return NULL;
+    }
+    memcpy(rv->str, str, len);
+    rv->str[len] = '\0';
+
+    rv->hash = hash;
+    rv->font = PCF_FontRef(font);
+    rv->color = *color;
+    rv->tight = tight;
+    rv->len = len;
+
+    PCF_FontGetSizeRequestLen(font, rv->str, len, false, &w, &h);
+    if(tight)
+        h -= PCF_FontGetStringTopInkOffsetLen(font, rv->str, len);
+    rv->w = w;
+    rv->h = h;
+    if(!w || !h) /*Nothing to draw (e.g empty string), keep a texture-less entry*/
+        return rv;
+
+    surface = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_RGBA32);
+    if(!surface)
+        goto bail;
+    PCF_FontWriteLen(font, rv->str, len,
+        SDL_MapRGBA(surface->format, color->r, color->g, color->b, color->a),
+        tight, surface, NULL
+    );
+    PCF_TRACE_BEGIN("PCF_TextCacheCreateTexture", font);
+    rv->texture = SDL_CreateTextureFromSurface(self->renderer, surface);
+    PCF_TRACE_END("PCF_TextCacheCreateTexture", font);
+    SDL_FreeSurface(surface);
+    if(!rv->texture)
+        goto bail;
+    rv->bytes = rv->w * rv->h * 4;
+
+    return rv;
+bail:
+    PCF_CloseFont(rv->font);
+    SDL_free(rv->str);
+    SDL_free(rv);
+    return NULL;
+}
+
+/**
+ * Draws a string on the cache renderer, re-using a previously made texture
+ * if that same string was drawn recently with the same font, color and
+ * tightness. Pixels drawn are the same as with PCF_FontRender.
+ *
+ * @param cache The cache to use. Its renderer is the one that will be drawn on.
+ * @param font The font to use. Opened by PCF_OpenFont. Cached textures
+ * hold a reference on it: the font can be closed while they are still in
+ * the cache.
+ * @param str The string to write.
+ * @param color The color of text. If NULL, the current renderer's color will
+ * be used.
+ * @param tight If true, the rendering will use ink metrics (tight bounding box)
+ * instead of full font metrics. This trims empty space above and below the text.
+ * @param location Where to write on the renderer. Can be NULL to write at
+ * 0,0. If not NULL, location will be advanced by the width of the string.
+ * @return True on success, false on error. Details of the failure can be
+ * retreived with SDL_GetError().
+ */
+bool PCF_TextCacheRender(PCF_TextCache *cache, PCF_Font *font, const char *str, SDL_Color *color, bool tight, SDL_Rect *location)
+{
+    return PCF_TextCacheRenderLen(cache, font, str, strlen(str), color, tight, location);
+}
+
+/**
+ * Same as PCF_TextCacheRender, for the first @p len bytes of @p str which
+ * doesn't need to be NUL-terminated.
+ *
+ * @param str The string to write.
+ * @param len The length of @p str in bytes.
+ * @see PCF_TextCacheRender for the other parameters and the return value.
+ */
+bool PCF_TextCacheRenderLen(PCF_TextCache *cache, PCF_Font *font, const char *str, size_t len, SDL_Color *color,
+                            bool tight, SDL_Rect *location)
+{
+    PCF_TextCacheEntry *entry;
+    SDL_Color rcolor;
+    Uint32 hash;
+
+    if(!color){
+        SDL_GetRenderDrawColor(cache->renderer, &rcolor.r, &rcolor.g, &rcolor.b, &rcolor.a);
+        color = &rcolor;
+    }
+
+    hash = text_cache_hash(font, str, len, color, tight);
+    entry = PCF_TextCacheLookup(cache, hash, font, str, len, color, tight);
+    if(entry){
+        cache->hits++;
+        PCF_TextCacheUnlinkLRU(cache, entry);
+    }else{
+        cache->misses++;
+        entry = PCF_TextCacheCreateEntry(cache, hash, font, str, len, color, tight);
+        if(!entry)
+            return false;
+
+        entry->next = cache->buckets[hash & (cache->nbuckets - 1)];
+        cache->buckets[hash & (cache->nbuckets - 1)] = entry;
+        cache->nentries++;
+        cache->bytes += entry->bytes;
+        if(cache->nentries > cache->nbuckets - cache->nbuckets/4)
+            PCF_TextCacheGrow(cache);
+    }
+    PCF_TextCachePushMRU(cache, entry);
+
+    /*Never evict the entry we are about to draw*/
+    while(cache->bytes > cache->max_bytes && cache->lru != entry)
+        PCF_TextCacheEvict(cache, cache->lru);
+
+    if(entry->texture){
+        SDL_Rect dst = (SDL_Rect){
+            location ? location->x : 0,
+            location ? location->y : 0,
+            entry->w,
+            entry->h
+        };
+        PCF_STATS_INC(renderer_calls);
+        if(SDL_RenderCopy(cache->renderer, entry->texture, NULL, &dst) != 0)
+            return false;
+    }
+    if(location)
+        location->x += entry->w;
+
+    return true;
+}
+
+#endif /* USE_SDL2_TEXTURE */
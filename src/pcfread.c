@@ -42,6 +42,8 @@ from The Open Group.
 
 #include "pcf.h"
 #include "pcfread.h"
+#include "pcfstats.h"
+#include "pcftrace.h"
 #include "SDL_GzRW.h"
 #include "utilbitmap.h"
 
@@ -443,18 +445,26 @@ pcfReadFont(FontPtr pFont, SDL_RWops *file,
     Uint32      bitmapSizes[GLYPHPADOPTIONS];
     Uint32     *offsets = 0;
     bool	hasBDFAccelerators;
+    const char *phase = NULL;
+    PCF_STATS_TICK(tick);
 
     pFont->info.nprops = 0;
     pFont->info.props = 0;
     pFont->info.isStringProp=0;
 
+    /* pFont is the PCF_Font being opened: xfont is its first member */
+    PCF_TRACE_PHASE(phase, "PCF_OpenFont/toc", pFont);
     if (!(tables = pcfReadTOC(file, &ntables)))
         goto Bail;
+    PCF_STATS_LAP(tick, toc);
+    PCF_TRACE_PHASE(phase, "PCF_OpenFont/properties", pFont);
 
     /* properties */
 
     if (!pcfGetProperties(&pFont->info, file, tables, ntables))
     	goto Bail;
+    PCF_STATS_LAP(tick, properties);
+    PCF_TRACE_PHASE(phase, "PCF_OpenFont/accelerators", pFont);
 
     /* Use the old accelerators if no BDF accelerators are in the file */
 
@@ -462,6 +472,8 @@ pcfReadFont(FontPtr pFont, SDL_RWops *file,
     if (!hasBDFAccelerators)
         if (!pcfGetAccel (&pFont->info, file, tables, ntables, PCF_ACCELERATORS))
             goto Bail;
+    PCF_STATS_LAP(tick, accelerators);
+    PCF_TRACE_PHASE(phase, "PCF_OpenFont/metrics", pFont);
 
     /* metrics */
 
@@ -496,6 +508,8 @@ pcfReadFont(FontPtr pFont, SDL_RWops *file,
             if (!pcfGetCompressedMetric(file, format, &(metrics + i)->metrics))
             goto Bail;
         }
+    PCF_STATS_LAP(tick, metrics);
+    PCF_TRACE_PHASE(phase, "PCF_OpenFont/bitmaps", pFont);
 
     /* bitmaps */
 
@@ -581,6 +595,8 @@ pcfReadFont(FontPtr pFont, SDL_RWops *file,
 
     free(offsets);
     offsets = NULL;
+    PCF_STATS_LAP(tick, bitmaps);
+    PCF_TRACE_PHASE(phase, "PCF_OpenFont/ink_metrics", pFont);
 
     /* ink metrics ? */
 
@@ -614,6 +630,8 @@ pcfReadFont(FontPtr pFont, SDL_RWops *file,
                     goto Bail;
             }
     }
+    PCF_STATS_LAP(tick, ink_metrics);
+    PCF_TRACE_PHASE(phase, "PCF_OpenFont/encodings", pFont);
 
     /* encoding */
 
@@ -659,12 +677,16 @@ pcfReadFont(FontPtr pFont, SDL_RWops *file,
             ACCESSENCODINGL(encoding, i) = metrics + encodingOffset;
         }
     }
+    PCF_STATS_LAP(tick, encodings);
+    PCF_TRACE_PHASE(phase, "PCF_OpenFont/accelerators", pFont);
 
     /* BDF style accelerators (i.e. bounds based on encoded glyphs) */
 
     if (hasBDFAccelerators)
 	if (!pcfGetAccel (&pFont->info, file, tables, ntables, PCF_BDF_ACCELERATORS))
 	    goto Bail;
+    PCF_STATS_LAP(tick, accelerators);
+    PCF_TRACE_PHASE(phase, NULL, pFont);
 
     bitmapFont = SDL_malloc(sizeof *bitmapFont);
     if (!bitmapFont) {
@@ -709,6 +731,7 @@ pcfReadFont(FontPtr pFont, SDL_RWops *file,
     free(tables);
     return Successful;
 Bail:
+    PCF_TRACE_PHASE(phase, NULL, pFont);
     free(ink_metrics);
     if(encoding) {
         for(i=0; i<NUM_SEGMENTS(nencoding); i++)
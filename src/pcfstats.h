@@ -0,0 +1,35 @@
+#ifndef PCFSTATS_H
+#define PCFSTATS_H
+
+#include "SDL_timer.h"
+#include "SDL_pcf.h"
+
+/* Runtime statistics, see PCF_GetStats. Counting is compiled out
+ * unless configured with --enable-stats.
+ * */
+#if PCF_HAVE_STATS
+extern PCF_Stats pcf_stats;
+
+#define PCF_STATS_ADD(field, n) (pcf_stats.field += (n))
+/*Declares @p tick, the start of the next PCF_STATS_LAP*/
+#define PCF_STATS_TICK(tick) Uint64 tick = SDL_GetPerformanceCounter()
+/*Adds the time elapsed since @p tick to load_times.@p table and restarts @p tick*/
+#define PCF_STATS_LAP(tick, table) pcf_stats_lap(&(tick), &pcf_stats.load_times.table)
+
+static inline void pcf_stats_lap(Uint64 *tick, double *ms)
+{
+    Uint64 now;
+
+    now = SDL_GetPerformanceCounter();
+    *ms += (now - *tick) * 1000.0 / SDL_GetPerformanceFrequency();
+    *tick = now;
+}
+#else
+#define PCF_STATS_ADD(field, n) ((void)0)
+#define PCF_STATS_TICK(tick)
+#define PCF_STATS_LAP(tick, table) ((void)0)
+#endif
+
+#define PCF_STATS_INC(field) PCF_STATS_ADD(field, 1)
+
+#endif /* PCFSTATS_H */
@@ -0,0 +1,37 @@
+#ifndef PCFTRACE_H
+#define PCFTRACE_H
+
+#include "SDL_pcf.h"
+
+/* Tracing hooks, see PCF_SetTraceHooks. Unlike statistics they are
+ * always built in: with no hooks set, each traced operation costs a test.
+ * */
+typedef struct{
+    PCF_TraceFunc begin;
+    PCF_TraceFunc end;
+    void *userdata;
+}PCF_TraceHooks;
+
+extern PCF_TraceHooks pcf_trace;
+
+#define PCF_TRACE_BEGIN(name, object) do{ \
+    if(pcf_trace.begin) pcf_trace.begin((name), (object), pcf_trace.userdata); \
+}while(0)
+
+#define PCF_TRACE_END(name, object) do{ \
+    if(pcf_trace.end) pcf_trace.end((name), (object), pcf_trace.userdata); \
+}while(0)
+
+/*Ends @p phase if it's not NULL, then begins @p next (if not NULL) which becomes @p phase*/
+#define PCF_TRACE_PHASE(phase, next, object) pcf_trace_phase(&(phase), (next), (object))
+
+static inline void pcf_trace_phase(const char **phase, const char *next, const void *object)
+{
+    if(*phase)
+        PCF_TRACE_END(*phase, object);
+    *phase = next;
+    if(next)
+        PCF_TRACE_BEGIN(next, object);
+}
+
+#endif /* PCFTRACE_H */
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "SDL_pcf.h"
+
+/*
+ * Caret and hit-testing test: checks PCF_StaticFontCaretRect and
+ * PCF_StaticFontHitTest against positions summed from the static font
+ * advances, for a monospace and a proportional font, with multi-byte
+ * UTF-8 input, scrolling and positions past the end of the string.
+ * Doesn't need a display.
+ *
+ * prop-test.pcf.gz is a synthetic proportional font: printable ASCII
+ * and U+00B0 with advances from 1 to 8 pixels, some of them narrower or
+ * wider than their glyph.
+ *
+ * Usage: caret-test
+ */
+#ifndef TEST_DIR
+#define TEST_DIR "."
+#endif
+
+#define MAX_CHARS 32
+
+typedef struct{
+    const char *name;
+    const char *filename;
+}TestFont;
+
+static const TestFont fonts[] = {
+    {"monospace", TEST_DIR "/ter-x24n.pcf.gz"},
+    {"proportional", TEST_DIR "/prop-test.pcf.gz"}
+};
+
+typedef struct{
+    const char *str;
+    int len; /*-1 for the whole string*/
+    int xoffset;
+}TestCase;
+
+static const TestCase cases[] = {
+    {"ab g\xc2\xb0 xy", -1, 0},
+    {"\xc2\xb0\xc2\xb0" "a\xc2\xb0", -1, 0},
+    {"ab g\xc2\xb0 xy", 6, 0}, /*Stops right after the degree sign*/
+    {"hello world", -1, -13}, /*Scrolled left*/
+    {"", -1, 0}
+};
+
+static int nfailures;
+
+#define CHECK(cond, ...) do{ \
+    if(!(cond)){ \
+        printf("FAIL %s \"%s\": ", name, test->str); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        nfailures++; \
+        return false; \
+    } \
+}while(0)
+
+/*
+ * Decodes the 1 or 2 bytes UTF-8 sequences used above.
+ */
+static Uint32 next_char(const char *str, int *i)
+{
+    const Uint8 *s = (const Uint8*)str + *i;
+
+    if(s[0] < 0x80){
+        (*i)++;
+        return s[0];
+    }
+    *i += 2;
+    return ((s[0] & 0x1f) << 6) | (s[1] & 0x3f);
+}
+
+/*
+ * Advance of @p c, straight from the static font tables.
+ */
+static int char_advance(PCF_StaticFont *font, Uint32 c)
+{
+    int i;
+
+    if(!font->glyph_widths)
+        return PCF_StaticFontCharWidth(font);
+    for(i = 0; i < font->nglyphs && font->glyphs[i] != c; i++)
+        ;
+    return font->glyph_widths[i].advance; /*The default glyph when missing*/
+}
+
+static bool run_case(const char *name, PCF_StaticFont *font, const TestCase *test)
+{
+    int pens[MAX_CHARS + 1], advances[MAX_CHARS + 1];
+    int nchars, len, expected;
+    SDL_Rect location, caret;
+    bool visible;
+
+    len = test->len < 0 ? (int)strlen(test->str) : test->len;
+    location = (SDL_Rect){10, 5, 0, PCF_StaticFontCharHeight(font)};
+    nchars = 0;
+    pens[0] = location.x + test->xoffset;
+    for(int i = 0; i < len; nchars++){
+        advances[nchars] = char_advance(font, next_char(test->str, &i));
+        pens[nchars + 1] = pens[nchars] + advances[nchars];
+    }
+    /*The caret past the end is as wide as a space*/
+    advances[nchars] = char_advance(font, ' ');
+    /*Room for the whole string and its end caret, minus the scrolled part*/
+    location.w = pens[nchars] + advances[nchars] - location.x + 5;
+
+    /*Carets: on each char, at the end and past it*/
+    for(int k = 0; k <= nchars + 3; k++){
+        int j = SDL_min(k, nchars);
+
+        visible = PCF_StaticFontCaretRect(font, test->str, test->len, &location, test->xoffset, k, &caret);
+        CHECK(   caret.x == pens[j] && caret.w == advances[j]
+              && caret.y == location.y && caret.h == PCF_StaticFontCharHeight(font),
+            "caret %d is at %d,%d %dx%d instead of %d,%d %dx%d", k,
+            caret.x, caret.y, caret.w, caret.h,
+            pens[j], location.y, advances[j], PCF_StaticFontCharHeight(font)
+        );
+        CHECK(visible == (pens[j] >= location.x), "caret %d visibility is %d", k, visible);
+    }
+
+    /*Hits: left half of a char goes before it, right half after it*/
+    for(int x = location.x; x < location.x + location.w; x++){
+        int k;
+
+        for(k = 0; k < nchars && x >= pens[k + 1]; k++)
+            ;
+        if(k == nchars)
+            expected = nchars;
+        else if(x < pens[0])
+            expected = 0;
+        else
+            expected = 2 * (x - pens[k]) < advances[k] ? k : k + 1;
+        for(int y = location.y; y < location.y + location.h; y += location.h - 1){
+            int hit = PCF_StaticFontHitTest(font, test->str, test->len, &location, test->xoffset, x, y);
+            CHECK(hit == expected, "hit at %d,%d is %d instead of %d", x, y, hit, expected);
+        }
+    }
+
+    /*Outside of location*/
+    CHECK(PCF_StaticFontHitTest(font, test->str, test->len, &location, test->xoffset, location.x - 1, location.y) == -1,
+        "hit left of location");
+    CHECK(PCF_StaticFontHitTest(font, test->str, test->len, &location, test->xoffset, location.x + location.w, location.y) == -1,
+        "hit right of location");
+    CHECK(PCF_StaticFontHitTest(font, test->str, test->len, &location, test->xoffset, location.x, location.y - 1) == -1,
+        "hit above location");
+    CHECK(PCF_StaticFontHitTest(font, test->str, test->len, &location, test->xoffset, location.x, location.y + location.h) == -1,
+        "hit below the line");
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    PCF_StaticFont *font;
+    PCF_Font *pfont;
+    int nchecks;
+
+    nchecks = 0;
+    for(size_t i = 0; i < SDL_arraysize(fonts); i++){
+        pfont = PCF_OpenFont(fonts[i].filename);
+        if(!pfont){
+            printf("%s\n", SDL_GetError());
+            exit(EXIT_FAILURE);
+        }
+        font = PCF_FontCreateStaticFont(pfont, &(SDL_Color){255, 255, 255, 255}, 2, ASCII_PRINTABLE, "\xc2\xb0");
+        PCF_CloseFont(pfont);
+        if(!font){
+            printf("%s\n", SDL_GetError());
+            exit(EXIT_FAILURE);
+        }
+        if(!font->glyph_widths != (i == 0)){
+            printf("%s is not %s\n", fonts[i].filename, fonts[i].name);
+            exit(EXIT_FAILURE);
+        }
+        for(size_t j = 0; j < SDL_arraysize(cases); j++, nchecks++)
+            run_case(fonts[i].name, font, &cases[j]);
+        PCF_FreeStaticFont(font);
+    }
+    printf("Checked %d strings, %d failures\n", nchecks, nfailures);
+
+    exit(nfailures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
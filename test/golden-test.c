@@ -0,0 +1,507 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+#include <SDL.h>
+
+#include "SDL_pcf.h"
+
+/*
+ * Pixel-exact regression test: renders a fixed corpus through every write
+ * path into offscreen surfaces and compares the result byte-for-byte
+ * with reference images. Then checks that PCF_NumberDisplay only repaints
+ * and reports the cells that change. Doesn't need a display.
+ *
+ * Usage: golden-test [-u] [references] [font-filename]
+ * -u (re)writes the references instead of checking against them: only do
+ * that after having made sure that an output change is intended.
+ */
+#ifndef GOLDEN_DIR
+#define GOLDEN_DIR "."
+#endif
+#define GOLDEN_IMAGES GOLDEN_DIR "/golden-images.gz"
+#define GOLDEN_FONT GOLDEN_DIR "/ter-x24n.pcf.gz"
+
+#define CORPUS_LINES 16
+#define CORPUS_CODES_PER_LINE 16
+
+/*Where the corpus gets written, relative to the surface*/
+typedef struct{
+    const char *name;
+    int w, h; /*Surface size, 0 for the size of the whole corpus*/
+    int x, y; /*Top-left corner of the corpus*/
+}Placement;
+
+typedef struct{
+    PCF_Font *font;
+    PCF_StaticFont *sfont;
+    /*All 256 codes, UTF-8 encoded. Code 0 is only reachable through the
+     *Len variants*/
+    char lines[CORPUS_LINES][CORPUS_CODES_PER_LINE * 2];
+    size_t lens[CORPUS_LINES];
+    int line_height;
+    Uint32 corpus_w, corpus_h;
+    gzFile references;
+    bool update;
+    int ncases, nfailures;
+}Golden;
+
+typedef bool (*DrawFunc)(Golden *self, SDL_Surface *surface, int x, int y, bool tight);
+
+static const Placement placements[] = {
+    {"full",        0,  0,    1,   1},
+    {"clip-left",   64, 48,  -5,   2},
+    {"clip-top",    64, 48,   2,  -7},
+    {"clip-right",  64, 48,  40,  30}, /*And bottom*/
+    {"clip-far",    64, 48, -100, -60}, /*Whole glyphs left of and above the surface*/
+    {"clip-beyond", 64, 48,  70,  50}  /*Starts past the right and bottom edges*/
+};
+
+static const Uint32 formats[] = {
+    SDL_PIXELFORMAT_INDEX8,
+    SDL_PIXELFORMAT_RGB565,
+    SDL_PIXELFORMAT_RGB24,
+    SDL_PIXELFORMAT_RGBA8888
+};
+
+static size_t utf8_encode(Uint32 c, char *dst)
+{
+    if(c < 0x80){
+        dst[0] = c;
+        return 1;
+    }
+    dst[0] = 0xc0 | (c >> 6);
+    dst[1] = 0x80 | (c & 0x3f);
+    return 2;
+}
+
+static bool draw_write(Golden *self, SDL_Surface *surface, int x, int y, bool tight)
+{
+    SDL_Rect location;
+    Uint32 color;
+
+    /*The default palette of 8 bits surfaces is all white: use a raw index*/
+    if(surface->format->BytesPerPixel == 1)
+        color = 0x5a;
+    else
+        color = SDL_MapRGB(surface->format, 255, 128, 0);
+
+    for(int i = 0; i < CORPUS_LINES; i++){
+        location = (SDL_Rect){x, y + i * self->line_height, 0, 0};
+        PCF_FontWriteLen(self->font, self->lines[i], self->lens[i], color, tight, surface, &location);
+    }
+    return true;
+}
+
+static bool draw_render(Golden *self, SDL_Surface *surface, int x, int y, bool tight)
+{
+    SDL_Renderer *renderer;
+    SDL_Rect location;
+
+    renderer = SDL_CreateSoftwareRenderer(surface);
+    if(!renderer){
+        printf("Couldn't create software renderer: %s\n", SDL_GetError());
+        return false;
+    }
+    for(int i = 0; i < CORPUS_LINES; i++){
+        location = (SDL_Rect){x, y + i * self->line_height, 0, 0};
+        PCF_FontRenderLen(self->font, self->lines[i], self->lens[i],
+                          &(SDL_Color){255, 128, 0, 255}, tight, renderer, &location);
+    }
+    SDL_RenderPresent(renderer);
+    SDL_DestroyRenderer(renderer);
+    return true;
+}
+
+/*Blits patches the way an application would, SDL clipping them*/
+static void blit_patches(Golden *self, SDL_Surface *surface, size_t npatches, PCF_StaticFontPatch *patches)
+{
+    for(size_t i = 0; i < npatches; i++){
+        if(patches[i].src.x < 0) /*space*/
+            continue;
+        SDL_BlitSurface(self->sfont->pages[patches[i].page], &patches[i].src,
+                        surface, &(SDL_Rect){patches[i].dst.x, patches[i].dst.y, 0, 0});
+    }
+}
+
+static bool draw_static(Golden *self, SDL_Surface *surface, int x, int y, bool tight)
+{
+    PCF_StaticFontPatch patches[CORPUS_CODES_PER_LINE];
+    SDL_Rect location;
+    size_t npatches;
+
+    for(int i = 0; i < CORPUS_LINES; i++){
+        location = (SDL_Rect){x, y + i * self->line_height, 0, 0};
+        npatches = PCF_StaticFontPreWriteString(self->sfont, self->lens[i], self->lines[i], tight,
+                                                &location, CORPUS_CODES_PER_LINE, patches);
+        blit_patches(self, surface, npatches, patches);
+    }
+    return true;
+}
+
+static bool draw_static_offset(Golden *self, SDL_Surface *surface, int x, int y, bool tight)
+{
+    PCF_StaticFontPatch patches[CORPUS_CODES_PER_LINE];
+    SDL_Rect clip;
+    size_t npatches;
+
+    clip = (SDL_Rect){0, 0, surface->w, surface->h};
+    for(int i = 0; i < CORPUS_LINES; i++){
+        npatches = PCF_StaticFontPreWriteStringOffset(self->sfont, self->lens[i], self->lines[i], tight,
+                                                      &clip, x, y + i * self->line_height,
+                                                      CORPUS_CODES_PER_LINE, patches);
+        blit_patches(self, surface, npatches, patches);
+    }
+    return true;
+}
+
+/*Pixel value, independent of the host byte order*/
+static Uint32 pixel_value(SDL_Surface *surface, int x, int y)
+{
+    Uint8 *p;
+
+    p = (Uint8 *)surface->pixels + y * surface->pitch + x * surface->format->BytesPerPixel;
+    switch(surface->format->BytesPerPixel){
+    case 1:
+        return *p;
+    case 2:
+        return *(Uint16 *)p;
+    case 3:
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+        return p[0] << 16 | p[1] << 8 | p[2];
+#else
+        return p[0] | p[1] << 8 | p[2] << 16;
+#endif
+    default:
+        return *(Uint32 *)p;
+    }
+}
+
+/*
+ * Reference images are stored one after the other: a "name w h bpp"
+ * line followed by w*h pixel values, each bpp bytes, little endian.
+ */
+static void golden_compare(Golden *self, const char *name, SDL_Surface *surface)
+{
+    char header[128], line[128];
+    Uint8 expected[4];
+    int bpp, w, h, rbpp;
+    Uint32 value, ref;
+
+    self->ncases++;
+    bpp = surface->format->BytesPerPixel;
+    snprintf(header, sizeof(header), "%s %d %d %d\n", name, surface->w, surface->h, bpp);
+    if(self->update){
+        gzputs(self->references, header);
+    }else if(!gzgets(self->references, line, sizeof(line))
+             || sscanf(line, "%*s %d %d %d", &w, &h, &rbpp) != 3){
+        printf("FAIL %s: no reference image (rerun with -u to create it)\n", name);
+        self->nfailures++;
+        return;
+    }else if(strcmp(line, header)){
+        printf("FAIL %s %d %d %d: reference image is %s", name, surface->w, surface->h, bpp, line);
+        self->nfailures++;
+        gzseek(self->references, (z_off_t)w * h * rbpp, SEEK_CUR);
+        return;
+    }
+
+    SDL_LockSurface(surface);
+    for(int y = 0; y < surface->h; y++){
+        for(int x = 0; x < surface->w; x++){
+            value = pixel_value(surface, x, y);
+            if(self->update){
+                for(int i = 0; i < bpp; i++)
+                    gzputc(self->references, (value >> (8 * i)) & 0xff);
+                continue;
+            }
+            if(gzread(self->references, expected, bpp) != bpp){
+                printf("FAIL %s: truncated reference image\n", name);
+                self->nfailures++;
+                SDL_UnlockSurface(surface);
+                return;
+            }
+            ref = 0;
+            for(int i = 0; i < bpp; i++)
+                ref |= (Uint32)expected[i] << (8 * i);
+            if(value != ref){
+                printf("FAIL %s: pixel %d,%d is 0x%0*x instead of 0x%0*x\n",
+                    name, x, y, bpp * 2, value, bpp * 2, ref
+                );
+                self->nfailures++;
+                /*Skip the rest of the image to stay in sync*/
+                gzseek(self->references, (surface->h - y) * surface->w * bpp - (x + 1) * bpp, SEEK_CUR);
+                SDL_UnlockSurface(surface);
+                return;
+            }
+        }
+    }
+    SDL_UnlockSurface(surface);
+}
+
+/*
+ * PCF_NumberDisplay steps: each update must report as dirty exactly the
+ * cells whose char changed, leave every other pixel alone and give the
+ * same field as a display drawing the value from scratch.
+ */
+#define NUMBER_CELLS 6
+
+typedef struct{
+    int value;
+    bool recolor; /*Swap text and background colors first*/
+    bool new_background; /*Only change the background color first*/
+    bool invalidate; /*Call PCF_NumberDisplayInvalidate first*/
+    int first, last; /*Cells expected to be repainted, -1 for none*/
+    bool fits;
+}NumberStep;
+
+static const NumberStep number_steps[] = {
+    {1234,    false, false, false,  0, 5, true}, /*First update repaints everything*/
+    {1235,    false, false, false,  5, 5, true},
+    {1235,    false, false, false, -1, -1, true}, /*Same value*/
+    {1245,    false, false, false,  4, 4, true},
+    {-1245,   false, false, false,  1, 1, true},
+    {99,      false, false, false,  1, 5, true}, /*Shorter, leading cells cleared*/
+    {1234567, false, false, false, -1, -1, false}, /*Too wide, field untouched*/
+    {-99999,  false, false, false,  0, 3, true}, /*All cells used*/
+    {-99999,  true,  false, false,  0, 5, true},
+    {-99999,  false, true,  false,  0, 5, true},
+    {-99999,  false, false, true,   0, 5, true},
+    {909,     false, false, false,  0, 4, true}
+};
+
+/*Compares @p area of @p a and @p b, or everything but @p area if @p outside*/
+static bool surfaces_match(SDL_Surface *a, SDL_Surface *b, SDL_Rect *area, bool outside, int *px, int *py)
+{
+    SDL_Point p;
+
+    for(p.y = 0; p.y < a->h; p.y++){
+        for(p.x = 0; p.x < a->w; p.x++){
+            if(SDL_PointInRect(&p, area) == outside)
+                continue;
+            if(pixel_value(a, p.x, p.y) != pixel_value(b, p.x, p.y)){
+                *px = p.x;
+                *py = p.y;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool golden_number_display(Golden *self)
+{
+    SDL_Surface *surface, *before, *fresh;
+    PCF_NumberDisplay *display, *reference;
+    Uint32 color, background, tmp;
+    SDL_Rect dirty, expected;
+    int w, h, x, y;
+    bool rv, ok;
+
+    display = PCF_CreateNumberDisplay(self->font, 5, 3, NUMBER_CELLS, TypeInt, 0);
+    if(!display){
+        printf("%s\n", SDL_GetError());
+        return false;
+    }
+    w = display->location.x + display->location.w + 5;
+    h = display->location.y + display->location.h + 5;
+    surface = SDL_CreateRGBSurfaceWithFormat(0, w, h, 0, SDL_PIXELFORMAT_RGBA8888);
+    before = SDL_CreateRGBSurfaceWithFormat(0, w, h, 0, SDL_PIXELFORMAT_RGBA8888);
+    fresh = SDL_CreateRGBSurfaceWithFormat(0, w, h, 0, SDL_PIXELFORMAT_RGBA8888);
+    if(!surface || !before || !fresh){
+        printf("Couldn't create surface: %s\n", SDL_GetError());
+        rv = false;
+        goto end;
+    }
+    SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+    SDL_FillRect(surface, NULL, SDL_MapRGB(surface->format, 0, 0, 255));
+    color = SDL_MapRGB(surface->format, 255, 128, 0);
+    background = SDL_MapRGB(surface->format, 32, 32, 32);
+
+    rv = true;
+    for(size_t i = 0; i < SDL_arraysize(number_steps); i++){
+        const NumberStep *step = &number_steps[i];
+
+        self->ncases++;
+        if(step->recolor){
+            tmp = color;
+            color = background;
+            background = tmp;
+        }
+        if(step->new_background)
+            background = SDL_MapRGB(surface->format, 0, 96, 0);
+        if(step->invalidate)
+            PCF_NumberDisplayInvalidate(display);
+        SDL_BlitSurface(surface, NULL, before, NULL);
+
+        ok = PCF_NumberDisplayUpdate(display, (void*)&step->value, color, background, surface, &dirty);
+        expected = (SDL_Rect){display->location.x, display->location.y, 0, 0};
+        if(step->first >= 0){
+            expected.x += step->first * display->cell_w;
+            expected.w = (step->last - step->first + 1) * display->cell_w;
+            expected.h = display->location.h;
+        }
+        if(ok != step->fits){
+            printf("FAIL number-display-%zu: %d: update returned %d\n", i, step->value, ok);
+            self->nfailures++;
+            continue;
+        }
+        if(!SDL_RectEquals(&dirty, &expected)){
+            printf("FAIL number-display-%zu: %d: dirty rect is %d,%d %dx%d instead of %d,%d %dx%d\n",
+                i, step->value, dirty.x, dirty.y, dirty.w, dirty.h,
+                expected.x, expected.y, expected.w, expected.h
+            );
+            self->nfailures++;
+            continue;
+        }
+        if(!surfaces_match(surface, before, &dirty, true, &x, &y)){
+            printf("FAIL number-display-%zu: %d: pixel %d,%d changed outside of the dirty rect\n",
+                i, step->value, x, y
+            );
+            self->nfailures++;
+            continue;
+        }
+        if(!ok)
+            continue;
+
+        /*Incremental updates must add up to the whole value*/
+        reference = PCF_CreateNumberDisplay(self->font, display->location.x, display->location.y,
+                                            NUMBER_CELLS, TypeInt, 0);
+        if(!reference){
+            printf("%s\n", SDL_GetError());
+            rv = false;
+            break;
+        }
+        PCF_NumberDisplayUpdate(reference, (void*)&step->value, color, background, fresh, NULL);
+        PCF_FreeNumberDisplay(reference);
+        if(!surfaces_match(surface, fresh, &display->location, false, &x, &y)){
+            printf("FAIL number-display-%zu: %d: pixel %d,%d differs from a full repaint\n",
+                i, step->value, x, y
+            );
+            self->nfailures++;
+        }
+    }
+
+end:
+    SDL_FreeSurface(fresh);
+    SDL_FreeSurface(before);
+    SDL_FreeSurface(surface);
+    PCF_FreeNumberDisplay(display);
+    return rv;
+}
+
+static bool golden_run(Golden *self, const char *path, DrawFunc draw, const Uint32 *formats, size_t nformats)
+{
+    const Placement *p;
+    SDL_Surface *surface;
+    char name[128];
+    int w, h;
+
+    for(size_t f = 0; f < nformats; f++){
+        for(int tight = 0; tight < 2; tight++){
+            for(size_t i = 0; i < SDL_arraysize(placements); i++){
+                p = &placements[i];
+                w = p->w ? p->w : self->corpus_w + 2;
+                h = p->h ? p->h : self->corpus_h + 2;
+                surface = SDL_CreateRGBSurfaceWithFormat(0, w, h, 0, formats[f]);
+                if(!surface){
+                    printf("Couldn't create surface: %s\n", SDL_GetError());
+                    return false;
+                }
+                if(!draw(self, surface, p->x, p->y, tight)){
+                    SDL_FreeSurface(surface);
+                    return false;
+                }
+                snprintf(name, sizeof(name), "%s-%dbpp-%s-%s", path,
+                    surface->format->BytesPerPixel,
+                    tight ? "tight" : "normal",
+                    p->name
+                );
+                golden_compare(self, name, surface);
+                SDL_FreeSurface(surface);
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    Golden golden = {0};
+    const char *references, *font;
+    const Uint32 renderer_formats[] = {SDL_PIXELFORMAT_RGB565, SDL_PIXELFORMAT_RGBA8888};
+    const Uint32 atlas_formats[] = {SDL_PIXELFORMAT_RGBA32};
+    char set[256 * 2];
+    size_t len;
+    int arg;
+    bool rv;
+
+    arg = 1;
+    if(argc > arg && !strcmp(argv[arg], "-u")){
+        golden.update = true;
+        arg++;
+    }
+    references = argc > arg ? argv[arg++] : GOLDEN_IMAGES;
+    font = argc > arg ? argv[arg++] : GOLDEN_FONT;
+
+    golden.font = PCF_OpenFont(font);
+    if(!golden.font){
+        printf("%s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+
+    len = 0;
+    for(int i = 0; i < CORPUS_LINES; i++){
+        golden.lens[i] = 0;
+        for(int j = 0; j < CORPUS_CODES_PER_LINE; j++){
+            Uint32 c = i * CORPUS_CODES_PER_LINE + j;
+            golden.lens[i] += utf8_encode(c, golden.lines[i] + golden.lens[i]);
+            if(c > ' ') /*Static fonts sets are NUL-terminated*/
+                len += utf8_encode(c, set + len);
+        }
+    }
+    set[len] = '\0';
+
+    golden.sfont = PCF_FontCreateStaticFont(golden.font, &(SDL_Color){255, 128, 0, 255}, 1, set);
+    if(!golden.sfont){
+        printf("%s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+    /*Plain copies: blending is SDL's business, not ours*/
+    for(int i = 0; i < golden.sfont->npages; i++)
+        SDL_SetSurfaceBlendMode(golden.sfont->pages[i], SDL_BLENDMODE_NONE);
+
+    golden.line_height = PCF_FontCharHeight(golden.font);
+    golden.corpus_h = CORPUS_LINES * golden.line_height;
+    golden.corpus_w = 0;
+    for(int i = 0; i < CORPUS_LINES; i++){
+        Uint32 w, h;
+        PCF_FontGetSizeRequestLen(golden.font, golden.lines[i], golden.lens[i], false, &w, &h);
+        golden.corpus_w = SDL_max(golden.corpus_w, w);
+    }
+
+    golden.references = gzopen(references, golden.update ? "wb9" : "rb");
+    if(!golden.references){
+        printf("Couldn't open %s%s\n", references,
+            golden.update ? "" : " (run with -u to create it)"
+        );
+        exit(EXIT_FAILURE);
+    }
+
+    rv =    golden_run(&golden, "write", draw_write, formats, SDL_arraysize(formats))
+         && golden_run(&golden, "render", draw_render, renderer_formats, SDL_arraysize(renderer_formats))
+         && golden_run(&golden, "static", draw_static, atlas_formats, SDL_arraysize(atlas_formats))
+         && golden_run(&golden, "static-offset", draw_static_offset, atlas_formats, SDL_arraysize(atlas_formats))
+         && golden_number_display(&golden);
+    gzclose(golden.references);
+
+    printf("%s %d cases, %d failures\n",
+        golden.update ? "Wrote" : "Checked",
+        golden.ncases, golden.nfailures
+    );
+
+    PCF_FreeStaticFont(golden.sfont);
+    PCF_CloseFont(golden.font);
+
+    exit(rv && !golden.nfailures ? EXIT_SUCCESS : EXIT_FAILURE);
+}
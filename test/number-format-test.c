@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include <SDL.h>
+
+#include "SDL_pcf.h"
+
+/*
+ * Number formatting test: writes numbers with PCF_StaticFontPreWriteNumber
+ * and reads the patches back as text, checking integer limits, thousands
+ * grouping, padding, rounding and truncation, nan/inf and the values the
+ * formatter must refuse. Doesn't need a display.
+ *
+ * Usage: number-format-test [font-filename]
+ */
+#ifndef TEST_DIR
+#define TEST_DIR "."
+#endif
+#define TEST_FONT TEST_DIR "/ter-x24n.pcf.gz"
+
+/*Every char the formatter can output*/
+#define NUMBER_CHARS "0123456789-.,naif"
+#define MAX_PATCHES 64
+
+typedef struct{
+    PCF_NumberType type;
+    int8_t precision;
+    union{
+        int i;
+        unsigned int u;
+        int64_t i64;
+        uint64_t u64;
+        float f;
+        double d;
+    }value;
+    const char *expected; /*NULL when the value must be refused*/
+}TestCase;
+
+#define INT(v, p, t, e) {TypeInt | (t), p, .value.i = (v), e}
+#define UINT(v, p, t, e) {TypeIntUnsigned | (t), p, .value.u = (v), e}
+#define INT64(v, p, t, e) {TypeInt64 | (t), p, .value.i64 = (v), e}
+#define UINT64(v, p, t, e) {TypeIntUnsigned64 | (t), p, .value.u64 = (v), e}
+#define FLOAT(v, p, t, e) {TypeFloat | (t), p, .value.f = (v), e}
+#define DOUBLE(v, p, t, e) {TypeDouble | (t), p, .value.d = (v), e}
+
+static const TestCase cases[] = {
+    /*Integer limits*/
+    INT(INT_MIN, 0, 0, "-2147483648"),
+    INT(INT_MIN, 0, NumberThousands, "-2,147,483,648"),
+    INT(INT_MAX, 0, NumberThousands, "2,147,483,647"),
+    UINT(UINT_MAX, 0, 0, "4294967295"),
+    INT64(INT64_MIN, 0, NumberThousands, "-9,223,372,036,854,775,808"),
+    INT64(INT64_MAX, 0, 0, "9223372036854775807"),
+    UINT64(UINT64_MAX, 0, NumberThousands, "18,446,744,073,709,551,615"),
+    UINT64(0, 0, NumberThousands, "0"),
+    INT(999, 0, NumberThousands, "999"),
+    INT(-1000, 0, NumberThousands, "-1,000"),
+    /*Zero padding*/
+    INT(7, 3, 0, "007"),
+    INT(-7, 3, 0, "-007"),
+    INT(0, 0, 0, "0"),
+    INT(0, 2, 0, "00"),
+    INT(1234, 2, 0, "1234"),
+    UINT64(42, 5, 0, "00042"),
+    /*No negative zero*/
+    DOUBLE(-0.0001, 2, 0, "0.00"),
+    DOUBLE(-0.0001, 2, NumberTruncate, "0.00"),
+    DOUBLE(-0.0, 1, 0, "0.0"),
+    FLOAT(-0.4f, 0, 0, "0"),
+    /*Rounding and truncation*/
+    DOUBLE(3.141592, 3, 0, "3.142"),
+    DOUBLE(3.141592, 3, NumberTruncate, "3.141"),
+    DOUBLE(2.999, 2, 0, "3.00"),
+    DOUBLE(2.999, 2, NumberTruncate, "2.99"),
+    DOUBLE(-2.999, 2, 0, "-3.00"),
+    DOUBLE(-2.999, 2, NumberTruncate, "-2.99"),
+    DOUBLE(1.5, -1, 0, "1.500000"),
+    DOUBLE(1234567.891, 2, NumberThousands, "1,234,567.89"),
+    DOUBLE(0.49999999999999994, 0, 0, "0"),
+    FLOAT(0.29f, 2, 0, "0.29"),
+    FLOAT(0.29f, 2, NumberTruncate, "0.29"),
+    /*Ties round half to even, like printf*/
+    DOUBLE(0.5, 0, 0, "0"),
+    DOUBLE(1.5, 0, 0, "2"),
+    DOUBLE(2.5, 0, 0, "2"),
+    DOUBLE(3.5, 0, 0, "4"),
+    DOUBLE(-2.5, 0, 0, "-2"),
+    DOUBLE(0.125, 2, 0, "0.12"),
+    DOUBLE(0.375, 2, 0, "0.38"),
+    FLOAT(2.5f, 0, 0, "2"),
+    DOUBLE(3.5, 0, NumberTruncate, "3"),
+    /*nan and infinities*/
+    DOUBLE(NAN, 2, 0, "nan"),
+    DOUBLE(INFINITY, 2, 0, "inf"),
+    DOUBLE(-INFINITY, 2, 0, "-inf"),
+    FLOAT(-INFINITY, 0, NumberThousands, "-inf"),
+    /*Refused: more than 64 bits once scaled, too many decimals*/
+    DOUBLE(1e20, 0, 0, NULL),
+    DOUBLE(-1e20, 0, 0, NULL),
+    DOUBLE(100.0, 18, 0, NULL),
+    DOUBLE(1.0, 19, 0, NULL),
+    FLOAT(1.0f, 100, 0, NULL),
+    DOUBLE(18446744073709549568.0, 0, NumberThousands, "18,446,744,073,709,549,568"),
+    {TypeIntUnsigned64 + 1, 0, .value.u64 = 1, NULL}
+};
+
+/*
+ * Reads @p npatches patches made by PCF_StaticFontPreWriteNumber at 0,0
+ * back as text, each glyph being one column wide.
+ */
+static bool patches_to_text(PCF_StaticFont *font, PCF_StaticFontPatch *patches, size_t npatches, char *text)
+{
+    PCF_AtlasCell cell;
+    int cw;
+
+    cw = PCF_StaticFontCharWidth(font);
+    for(size_t i = 0; i < npatches; i++){
+        const char *c;
+
+        if(patches[i].dst.x != (int)i * cw)
+            return false;
+        for(c = NUMBER_CHARS; *c; c++){
+            if(   PCF_StaticFontGetCharCell(font, *c, &cell) > 0
+               && SDL_RectEquals(&cell.src, &patches[i].src)
+               && cell.page == patches[i].page)
+                break;
+        }
+        if(!*c)
+            return false;
+        text[i] = *c;
+    }
+    text[npatches] = '\0';
+    return true;
+}
+
+static const char *type_name(PCF_NumberType type)
+{
+    static const char *names[] = {"int", "unsigned", "float", "double", "int64", "uint64"};
+    type &= ~(NumberTruncate | NumberThousands);
+
+    return type < SDL_arraysize(names) ? names[type] : "unknown type";
+}
+
+static bool run_case(PCF_StaticFont *font, const TestCase *test, int n)
+{
+    PCF_StaticFontPatch patches[MAX_PATCHES];
+    char text[MAX_PATCHES + 1];
+    size_t rv;
+
+    rv = PCF_StaticFontPreWriteNumber(font, (void*)&test->value, test->type, test->precision,
+                                      false, NULL, MAX_PATCHES, patches);
+    if(!test->expected){
+        if(!rv)
+            return true;
+        printf("FAIL %d (%s): value wasn't refused\n", n, type_name(test->type));
+        return false;
+    }
+    if(!rv){
+        printf("FAIL %d (%s): expected \"%s\", got an error: %s\n", n, type_name(test->type), test->expected, SDL_GetError());
+        return false;
+    }
+    if(!patches_to_text(font, patches, rv, text)){
+        printf("FAIL %d (%s): expected \"%s\", patches don't read as text\n", n, type_name(test->type), test->expected);
+        return false;
+    }
+    if(strcmp(text, test->expected)){
+        printf("FAIL %d (%s): expected \"%s\", got \"%s\"\n", n, type_name(test->type), test->expected, text);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Output longer than the patches array is cut, never written past it.
+ */
+static bool check_patches_limit(PCF_StaticFont *font)
+{
+    PCF_StaticFontPatch patches[6];
+    char text[6];
+    uint64_t value = UINT64_MAX;
+    size_t rv;
+
+    memset(&patches[5], 0xaa, sizeof(PCF_StaticFontPatch));
+    rv = PCF_StaticFontPreWriteNumber(font, &value, TypeIntUnsigned64 | NumberThousands, 0, false, NULL, 5, patches);
+    if(rv != 5 || !patches_to_text(font, patches, rv, text) || strcmp(text, "18,44")){
+        printf("FAIL patches limit: got %zu patches\n", rv);
+        return false;
+    }
+    for(size_t i = 0; i < sizeof(PCF_StaticFontPatch); i++){
+        if(((Uint8*)&patches[5])[i] != 0xaa){
+            printf("FAIL patches limit: wrote past the patches array\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    PCF_Font *pfont;
+    PCF_StaticFont *font;
+    int nfailures;
+
+    pfont = PCF_OpenFont(argc > 1 ? argv[1] : TEST_FONT);
+    if(!pfont){
+        printf("%s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+    font = PCF_FontCreateStaticFont(pfont, &(SDL_Color){255, 255, 255, 255}, 1, NUMBER_CHARS);
+    PCF_CloseFont(pfont);
+    if(!font){
+        printf("%s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+
+    nfailures = 0;
+    for(size_t i = 0; i < SDL_arraysize(cases); i++)
+        nfailures += !run_case(font, &cases[i], i);
+    nfailures += !check_patches_limit(font);
+    printf("Checked %d numbers, %d failures\n", (int)SDL_arraysize(cases) + 1, nfailures);
+
+    PCF_FreeStaticFont(font);
+    exit(nfailures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -16,8 +16,8 @@ typedef struct{
     PCF_NumberType type;
 }ValueSample;
 
-ValueSample samples[3];
-int nsamples = 3;
+ValueSample samples[4];
+int nsamples = 4;
 int current_sample;
 
 int current_precision;
@@ -74,11 +74,13 @@ void pretty_placement(PCF_TextPlacement placement)
 
 const char *pretty_type(PCF_NumberType type)
 {
-    switch(type){
+    switch(type & ~(NumberTruncate | NumberThousands)){
         case TypeInt: return "TypeInt";
         case TypeIntUnsigned: return "TypeIntUnsigned";
         case TypeFloat: return "TypeFloat";
         case TypeDouble: return "TypeDouble";
+        case TypeInt64: return "TypeInt64";
+        case TypeIntUnsigned64: return "TypeIntUnsigned64";
     }
     return "TypeUnknown";
 }
@@ -142,7 +144,7 @@ bool handle_keyboard(SDL_KeyboardEvent *event)
         case SDLK_v: //Cycle through values
             if(event->state != SDL_PRESSED)
                 break;
-            if(current_sample < nsamples)
+            if(current_sample < nsamples - 1)
                 current_sample++;
             else
                 current_sample = 0;
@@ -233,6 +235,7 @@ int main(int argc, char *argv[])
     int ival = 2;
     float fval = 3.141592;
     double dval = 3.141592;
+    int64_t lval = -9876543210;
 
     samples[0].value = &ival;
     samples[0].type = TypeInt;
@@ -240,6 +243,8 @@ int main(int argc, char *argv[])
     samples[1].type = TypeFloat;
     samples[2].value = &dval;
     samples[2].type = TypeDouble;
+    samples[3].value = &lval;
+    samples[3].type = TypeInt64 | NumberThousands;
 
     done = false;
     placement = CenterOnCol | CenterOnRow;
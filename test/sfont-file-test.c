@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "SDL_pcf.h"
+
+/*
+ * Static font files round-trip test: saves static fonts made with various
+ * options to memory, checks that atlas pages pixels start on
+ * PCF_STATIC_FONT_FILE_ALIGN boundaries, loads them back and compares
+ * them with the originals. Then checks that truncated files and files
+ * with a corrupted header are rejected. Doesn't need a display.
+ *
+ * Usage: sfont-file-test [font-filename]
+ */
+#ifndef TEST_DIR
+#define TEST_DIR "."
+#endif
+#define TEST_FONT TEST_DIR "/ter-x24n.pcf.gz"
+
+/*Room for the largest case below*/
+#define FILE_BUFFER_SIZE (4 * 1024 * 1024)
+
+/*File layout bits, see the comment above PCF_StaticFontSaveRW*/
+#define FILE_HEADER_SIZE 34
+#define FILE_EFFECT_SIZE 8
+#define FILE_PAGE_COLS_OFFSET 10
+#define FILE_PAGE_ROWS_OFFSET 12
+#define FILE_SCALE_OFFSET 15
+#define FILE_FLAGS_OFFSET 32
+#define FILE_PROPORTIONAL (1 << 0)
+
+typedef struct{
+    const char *name;
+    const char *set;
+    PCF_StaticFontOptions options;
+}TestCase;
+
+static const TestCase cases[] = {
+    {"rgba32", "0123456789", {0}},
+    {"index8", ASCII_PRINTABLE, {.format = AtlasIndex8}},
+    {"small-pages", ASCII_PRINTABLE, {.max_page_width = 128, .max_page_height = 128}},
+    {"index8-outline", ASCII_PRINTABLE, {
+        .format = AtlasIndex8,
+        .max_page_width = 200,
+        .max_page_height = 100,
+        .effect = EffectOutline,
+        .effect_color = {0, 0, 0, 255}
+    }},
+    {"shadow-scale", PCF_DIGITS, {
+        .effect = EffectShadow,
+        .effect_color = {64, 64, 64, 255},
+        .shadow_offset = {2, 1},
+        .scale = 2
+    }}
+};
+
+static int nfailures;
+
+#define CHECK(cond, ...) do{ \
+    if(!(cond)){ \
+        printf("FAIL %s: ", name); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        nfailures++; \
+        return false; \
+    } \
+}while(0)
+
+static Uint16 read_le16(const Uint8 *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static void write_le16(Uint8 *p, Uint16 v)
+{
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+/*
+ * Walks the saved file up to the pages pixels and checks that each page
+ * is where it's supposed to be: on an aligned offset, after zeroed padding.
+ */
+static bool check_layout(const char *name, PCF_StaticFont *font, const Uint8 *data, size_t size)
+{
+    size_t offset, start, row;
+    Uint16 version, flags;
+    int npages, nglyphs;
+
+    CHECK(size >= FILE_HEADER_SIZE, "file is only %zu bytes", size);
+    version = read_le16(data + 4);
+    npages = data[7];
+    nglyphs = read_le16(data + 8);
+    flags = read_le16(data + FILE_FLAGS_OFFSET);
+    CHECK(npages == font->npages && nglyphs == font->nglyphs,
+        "header has %d pages, %d glyphs instead of %d, %d", npages, nglyphs, font->npages, font->nglyphs);
+
+    offset = FILE_HEADER_SIZE;
+    if(version >= 2)
+        offset += FILE_EFFECT_SIZE;
+    offset += npages * 4; /*Page sizes*/
+    offset += nglyphs * 4; /*Codepoints*/
+    offset += nglyphs * 4; /*Ink heights*/
+    offset += (nglyphs + 1) * 10; /*Cells*/
+    if(flags & FILE_PROPORTIONAL)
+        offset += (nglyphs + 1) * 6;
+    if(font->format == AtlasIndex8){
+        for(int i = 0; i < npages; i++){
+            CHECK(offset + 2 <= size, "truncated palettes");
+            offset += 2 + read_le16(data + offset) * sizeof(SDL_Color);
+        }
+    }
+
+    for(int i = 0; i < npages; i++){
+        SDL_Surface *page = font->pages[i];
+
+        start = (offset + PCF_STATIC_FONT_FILE_ALIGN - 1) / PCF_STATIC_FONT_FILE_ALIGN * PCF_STATIC_FONT_FILE_ALIGN;
+        for(; offset < start; offset++)
+            CHECK(offset < size && !data[offset], "page %d: non-zero padding byte at %zu", i, offset);
+
+        row = page->w * page->format->BytesPerPixel;
+        CHECK(start + row * page->h <= size, "page %d: truncated pixels", i);
+        for(int y = 0; y < page->h; y++){
+            CHECK(!memcmp(data + start + y * row, (Uint8*)page->pixels + y * page->pitch, row),
+                "page %d: pixels not found at aligned offset %zu", i, start);
+        }
+        offset = start + row * page->h;
+    }
+    CHECK(offset == size, "%zu trailing bytes", size - offset);
+    return true;
+}
+
+static bool check_same(const char *name, PCF_StaticFont *font, PCF_StaticFont *loaded)
+{
+    size_t row;
+
+    CHECK(loaded->format == font->format, "format %d instead of %d", loaded->format, font->format);
+    CHECK(loaded->npages == font->npages, "%d pages instead of %d", loaded->npages, font->npages);
+    CHECK(loaded->nglyphs == font->nglyphs, "%d glyphs instead of %d", loaded->nglyphs, font->nglyphs);
+    CHECK(!memcmp(&loaded->metrics, &font->metrics, sizeof(xCharInfo)), "metrics differ");
+    CHECK(!memcmp(&loaded->margin, &font->margin, sizeof(PCF_CellMargin)), "margins differ");
+    CHECK(loaded->scale == font->scale, "scale %d instead of %d", loaded->scale, font->scale);
+
+    for(int i = 0; i < font->nglyphs; i++){
+        CHECK(loaded->glyphs[i] == font->glyphs[i],
+            "glyph %d is U+%04X instead of U+%04X", i, loaded->glyphs[i], font->glyphs[i]);
+        CHECK(   loaded->glyph_heights[i].ascent == font->glyph_heights[i].ascent
+              && loaded->glyph_heights[i].descent == font->glyph_heights[i].descent,
+            "glyph %d: ink heights differ", i);
+    }
+    for(int i = 0; i <= font->nglyphs; i++){
+        CHECK(   SDL_RectEquals(&loaded->cells[i].src, &font->cells[i].src)
+              && loaded->cells[i].page == font->cells[i].page,
+            "cell %d differs", i);
+    }
+    CHECK(!loaded->glyph_widths == !font->glyph_widths, "proportional flag differs");
+    for(int i = 0; font->glyph_widths && i <= font->nglyphs; i++){
+        CHECK(!memcmp(&loaded->glyph_widths[i], &font->glyph_widths[i], sizeof(GlyphWidth)),
+            "glyph %d: widths differ", i);
+    }
+
+    for(int i = 0; i < font->npages; i++){
+        SDL_Surface *a = font->pages[i];
+        SDL_Surface *b = loaded->pages[i];
+
+        CHECK(a->w == b->w && a->h == b->h, "page %d is %dx%d instead of %dx%d", i, b->w, b->h, a->w, a->h);
+        CHECK(a->format->format == b->format->format, "page %d: pixel format differs", i);
+        row = a->w * a->format->BytesPerPixel;
+        for(int y = 0; y < a->h; y++)
+            CHECK(!memcmp((Uint8*)a->pixels + y * a->pitch, (Uint8*)b->pixels + y * b->pitch, row),
+                "page %d: line %d differs", i, y);
+        if(font->format == AtlasIndex8){
+            CHECK(   a->format->palette->ncolors == b->format->palette->ncolors
+                  && !memcmp(a->format->palette->colors, b->format->palette->colors,
+                             a->format->palette->ncolors * sizeof(SDL_Color)),
+                "page %d: palette differs", i);
+        }
+    }
+    return true;
+}
+
+static bool run_case(PCF_Font *pfont, const TestCase *test, Uint8 *buffer)
+{
+    const char *name = test->name;
+    PCF_StaticFont *font, *loaded;
+    SDL_RWops *rw;
+    Sint64 size;
+    bool rv;
+
+    font = PCF_FontCreateStaticFontWithOptions(pfont, &(SDL_Color){255, 255, 255, 255},
+                                               (PCF_StaticFontOptions*)&test->options, 1, test->set);
+    CHECK(font, "%s", SDL_GetError());
+
+    rw = SDL_RWFromMem(buffer, FILE_BUFFER_SIZE);
+    rv = rw && PCF_StaticFontSaveRW(font, rw, false);
+    size = rw ? SDL_RWtell(rw) : 0;
+    if(rw)
+        SDL_RWclose(rw);
+    if(!rv){
+        PCF_FreeStaticFont(font);
+        CHECK(false, "couldn't save: %s", SDL_GetError());
+    }
+
+    rv = check_layout(name, font, buffer, size);
+    loaded = PCF_StaticFontLoadRW(SDL_RWFromConstMem(buffer, size), true);
+    if(!loaded){
+        PCF_FreeStaticFont(font);
+        CHECK(false, "couldn't load: %s", SDL_GetError());
+    }
+    rv = check_same(name, font, loaded) && rv;
+
+    PCF_FreeStaticFont(loaded);
+    PCF_FreeStaticFont(font);
+    return rv;
+}
+
+typedef struct{
+    const char *name;
+    size_t size; /*0 to keep the whole file*/
+    size_t offset; /*Where to write value, 0 to leave the contents alone*/
+    Uint16 value;
+    bool byte; /*Write value as a Uint8 instead of a Uint16*/
+}Corruption;
+
+/*
+ * Corrupts a copy of a saved file with @p corrupt and makes sure that
+ * PCF_StaticFontLoadRW refuses it.
+ */
+static bool check_rejected(const char *name, const Uint8 *data, size_t size, Uint8 *copy, const Corruption *corrupt)
+{
+    PCF_StaticFont *loaded;
+
+    memcpy(copy, data, size);
+    if(corrupt->size)
+        size = corrupt->size;
+    if(corrupt->offset && corrupt->byte)
+        copy[corrupt->offset] = corrupt->value;
+    else if(corrupt->offset)
+        write_le16(copy + corrupt->offset, corrupt->value);
+
+    loaded = PCF_StaticFontLoadRW(SDL_RWFromConstMem(copy, size), true);
+    if(loaded)
+        PCF_FreeStaticFont(loaded);
+    CHECK(!loaded, "%s: corrupted file was loaded", corrupt->name);
+    return true;
+}
+
+static bool run_corruptions(PCF_Font *pfont, Uint8 *buffer)
+{
+    const char *name = "corrupted";
+    PCF_StaticFont *font, *loaded;
+    Uint8 *copy;
+    SDL_RWops *rw;
+    size_t size;
+    size_t pages; /*Offset of the first page size*/
+    Uint16 page_h, cell_h;
+
+    font = PCF_FontCreateStaticFont(pfont, &(SDL_Color){255, 255, 255, 255}, 1, ASCII_PRINTABLE);
+    CHECK(font, "%s", SDL_GetError());
+    rw = SDL_RWFromMem(buffer, FILE_BUFFER_SIZE);
+    if(!rw || !PCF_StaticFontSaveRW(font, rw, false)){
+        PCF_FreeStaticFont(font);
+        CHECK(false, "couldn't save: %s", SDL_GetError());
+    }
+    size = SDL_RWtell(rw);
+    SDL_RWclose(rw);
+    cell_h = PCF_StaticFontCellHeight(font);
+    PCF_FreeStaticFont(font);
+
+    pages = FILE_HEADER_SIZE + FILE_EFFECT_SIZE;
+    page_h = read_le16(buffer + pages + 2);
+    CHECK(page_h / cell_h >= 2, "first page has less than 2 rows of glyphs");
+
+    const Corruption corruptions[] = {
+        {"single byte", .size = 1},
+        {"truncated magic", .size = 3},
+        {"truncated header", .size = FILE_HEADER_SIZE - 1},
+        {"truncated effect block", .size = FILE_HEADER_SIZE + 4},
+        {"truncated page sizes", .size = pages + 2},
+        {"truncated codepoints", .size = pages + 4 + 100},
+        {"truncated pixels", .size = size - 1},
+        {"bad magic", .offset = 1, .value = 'X', .byte = true},
+        {"unknown version", .offset = 4, .value = 99},
+        {"unknown format", .offset = 6, .value = 42, .byte = true},
+        {"no pages", .offset = 7, .value = 0, .byte = true},
+        {"no page rows", .offset = FILE_PAGE_ROWS_OFFSET, .value = 0},
+        {"too few page rows", .offset = FILE_PAGE_ROWS_OFFSET, .value = 1},
+        {"page cols not matching page width", .offset = FILE_PAGE_COLS_OFFSET,
+         .value = read_le16(buffer + FILE_PAGE_COLS_OFFSET) + 1},
+        {"page height not a multiple of cells", .offset = pages + 2, .value = page_h - 1},
+        {"page width not matching page cols", .offset = pages, .value = read_le16(buffer + pages) + 1},
+        {"scale too large", .offset = FILE_SCALE_OFFSET, .value = PCF_STATIC_FONT_MAX_SCALE + 1, .byte = true},
+    };
+
+    copy = malloc(size);
+    CHECK(copy, "couldn't allocate file copy");
+    for(size_t i = 0; i < SDL_arraysize(corruptions); i++)
+        check_rejected(name, buffer, size, copy, &corruptions[i]);
+    free(copy);
+
+    /*The untouched file still loads and can grow*/
+    loaded = PCF_StaticFontLoadRW(SDL_RWFromConstMem(buffer, size), true);
+    CHECK(loaded, "couldn't load: %s", SDL_GetError());
+    if(!PCF_StaticFontEnsureGlyphs(loaded, pfont, "\xc3\xa9\xc3\xa0")){
+        PCF_FreeStaticFont(loaded);
+        CHECK(false, "couldn't grow loaded font: %s", SDL_GetError());
+    }
+    PCF_FreeStaticFont(loaded);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    PCF_Font *font;
+    Uint8 *buffer;
+
+    font = PCF_OpenFont(argc > 1 ? argv[1] : TEST_FONT);
+    if(!font){
+        printf("%s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+    buffer = malloc(FILE_BUFFER_SIZE);
+    if(!buffer){
+        printf("Couldn't allocate file buffer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for(size_t i = 0; i < SDL_arraysize(cases); i++)
+        run_case(font, &cases[i], buffer);
+    run_corruptions(font, buffer);
+    printf("Checked %d static font files and corrupted copies, %d failures\n", (int)SDL_arraysize(cases), nfailures);
+
+    free(buffer);
+    PCF_CloseFont(font);
+
+    exit(nfailures ? EXIT_FAILURE : EXIT_SUCCESS);
+}